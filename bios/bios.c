@@ -4,6 +4,7 @@
 #include <stddef.h>
 #include <libc/include/string.h>
 #include "../fs/include/fs.h"
+#include "../kernel/vmm.h"
 
 // Simple delay function
 static void delay(int count) {
@@ -20,8 +21,8 @@ static bios_config_t bios_config = {
 
 void bios_init(void) {
     // Detect memory from e820 map provided by bootloader
-    uint32_t num_entries = *(uint32_t*)0x8500;
-    e820_entry_t* mem_map = (e820_entry_t*)0x8504;
+    uint32_t num_entries = *(uint32_t*)PHYS_TO_VIRT(E820_MAP_ADDR);
+    e820_entry_t* mem_map = (e820_entry_t*)PHYS_TO_VIRT(E820_ENTRIES_ADDR);
     
     uint64_t total_mem = 0;
     
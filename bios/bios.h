@@ -14,6 +14,11 @@ typedef struct __attribute__((packed)) {
     uint32_t acpi_ext;
 } e820_entry_t;
 
+// Where boot.asm leaves the E820 map: entry count, then the entries
+// (physical addresses)
+#define E820_MAP_ADDR     0x0500
+#define E820_ENTRIES_ADDR (E820_MAP_ADDR + 4)
+
 // E820 memory types
 #define E820_RAM        1   // Usable memory
 #define E820_RESERVED   2   // Reserved memory
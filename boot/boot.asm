@@ -1,6 +1,17 @@
 [org 0x7c00]
 bits 16
 
+; Disk layout in sectors, passed in by the Makefile
+%ifndef KERNEL_SECTORS
+%define KERNEL_SECTORS 256
+%endif
+%ifndef INITRD_SECTORS
+%define INITRD_SECTORS 1
+%endif
+
+KERNEL_SEGMENT equ 0x0800   ; Kernel is loaded at 0x8000
+INITRD_SEGMENT equ 0x6000   ; Initrd is loaded at 0x60000
+
 jmp start
 
 ; Function to print a string
@@ -22,32 +33,41 @@ print_string:
 ;------------------------------------------------------------------------------
 ; detect_memory
 ; Detects system memory using BIOS interrupt 0x15, EAX=0xE820.
-; Stores the memory map at 0x8500.
+; Stores the memory map at 0x0500, below the boot sector, so that loading the
+; kernel at 0x8000 does not overwrite it.
 ;------------------------------------------------------------------------------
+E820_MAP equ 0x0500         ; Entry count (dword), entries follow at +4
+E820_MAX equ 64             ; Keep the map below 0x1000
+
 detect_memory:
     pusha
-    mov dword [0x8500], 0 ; Number of entries
+    mov dword [E820_MAP], 0 ; Number of entries
     mov ebx, 0            ; EBX must be 0 for the first call
-    mov di, 0x8504        ; ES:DI points to the buffer for the entries
+    mov di, E820_MAP + 4  ; ES:DI points to the buffer for the entries
 .next_entry:
     mov eax, 0xe820       ; EAX = 0xE820
     mov edx, 0x534d4150   ; EDX = 'SMAP'
     mov ecx, 24           ; ECX = 24 bytes (size of the structure)
     int 0x15
-    jc .error             ; If carry is set, there was an error
+    jc .end_of_list       ; Carry after the first entry just ends the list
 
     cmp eax, 0x534d4150   ; Check for 'SMAP' signature
     jne .error
 
     add di, 24      ; The size of the returned structure
+    inc dword [E820_MAP]
     cmp ebx, 0      ; if ebx is 0, we are done
     je .done
+    cmp dword [E820_MAP], E820_MAX
+    jae .done
 
-    inc dword [0x8500]
     jmp .next_entry
 
+.end_of_list:
+    cmp dword [E820_MAP], 0
+    jne .done
 .error:
-    mov dword [0x8500], 0
+    mov dword [E820_MAP], 0
 .done:
     popa
     ret
@@ -102,17 +122,23 @@ start:
     mov si, msg_booting
     call print_string
 
-    ; Load kernel from disk
-    mov ah, 0x02        ; BIOS read sectors function
-    mov al, 64          ; Number of sectors to read (kernel is 64 sectors)
-    mov ch, 0           ; Cylinder 0
-    mov cl, 2           ; Start from sector 2 (1-based)
-    mov dh, 0           ; Head 0
-    mov dl, [boot_drive]; Boot drive
-    mov bx, 0x0000      ; ES:BX buffer address (ES=0x0000, BX=0x8000)
-    mov es, bx
-    mov bx, 0x8000
+    ; Query the drive geometry so sectors can be addressed by LBA
+    mov ah, 0x08
+    mov dl, [boot_drive]
+    xor di, di          ; ES:DI = 0 works around buggy BIOSes
     int 0x13
+    jc load_kernel      ; Keep the 1.44 MB floppy defaults
+    and cl, 0x3F
+    mov [sectors_per_track], cl
+    inc dh
+    mov [heads], dh
+
+load_kernel:
+    ; Load kernel from disk (starts at LBA 1, right after the boot sector)
+    mov ax, 1
+    mov cx, KERNEL_SECTORS
+    mov bx, KERNEL_SEGMENT
+    call read_sectors
     jnc load_initrd     ; Continue if no error
 
     mov si, msg_disk_error
@@ -120,17 +146,11 @@ start:
     jmp $
 
 load_initrd:
-    ; Load initrd from disk
-    mov ah, 0x02        ; BIOS read sectors function
-    mov al, 1           ; Number of sectors to read
-    mov ch, 1           ; Cylinder 1
-    mov cl, 12          ; Sector 12
-    mov dh, 1           ; Head 1
-    mov dl, [boot_drive]; Boot drive
-    mov bx, 0x2000      ; ES:BX buffer address (ES=0x2000, BX=0x0000)
-    mov es, bx
-    mov bx, 0x0000
-    int 0x13
+    ; Load initrd from disk (follows the kernel)
+    mov ax, 1 + KERNEL_SECTORS
+    mov cx, INITRD_SECTORS
+    mov bx, INITRD_SEGMENT
+    call read_sectors
     jnc continue_boot   ; Continue if no error
 
     ; Print error message and halt if read failed
@@ -138,6 +158,47 @@ load_initrd:
     call print_string
     jmp $
 
+;------------------------------------------------------------------------------
+; read_sectors
+; Reads CX sectors starting at LBA AX into memory at segment BX, one sector
+; at a time so that no read crosses a track or a 64 KB boundary.
+; Sets the carry flag on error.
+;------------------------------------------------------------------------------
+read_sectors:
+    pusha
+.next:
+    push ax
+    push cx
+    push bx
+    mov es, bx
+    xor dx, dx
+    movzx bx, byte [sectors_per_track]
+    div bx              ; AX = LBA / sectors, DX = LBA % sectors
+    mov cl, dl
+    inc cl              ; Sector (1-based)
+    xor dx, dx
+    movzx bx, byte [heads]
+    div bx              ; AX = cylinder, DX = head
+    mov dh, dl          ; Head
+    mov ch, al          ; Cylinder bits 0-7
+    shl ah, 6
+    or cl, ah           ; Cylinder bits 8-9
+    mov dl, [boot_drive]; Boot drive
+    xor bx, bx          ; ES:BX = segment:0
+    mov ax, 0x0201      ; Read one sector
+    int 0x13
+    pop bx
+    pop cx
+    pop ax
+    jc .done
+    inc ax
+    add bx, 0x20        ; Advance 512 bytes
+    loop .next
+    clc
+.done:
+    popa
+    ret
+
 continue_boot:
     ; Switch to protected mode
     cli
@@ -152,6 +213,8 @@ continue_boot:
     jmp CODE_SEG:p_mode_start
 
 boot_drive: db 0
+sectors_per_track: db 18
+heads: db 2
 
 msg_booting: db "Booting from disk...", 0x0D, 0x0A, 0
 msg_disk_error: db "Disk read error!", 0x0D, 0x0A, 0
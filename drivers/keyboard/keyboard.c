@@ -2,17 +2,18 @@
 #include "../../kernel/kernel.h"
 #include "../../kernel/vga.h"
 #include "../../kernel/pic.h"
+#include "../../kernel/zeropool.h"
+#include "../../kernel/ring.h"
 #include <stddef.h>
 
 // Current keyboard state
 static uint8_t keyboard_modifiers = 0;
 static bool keyboard_initialized = false;
 
-// Keyboard buffer (circular buffer)
+// Scancodes from the IRQ handler to the readers; a power of two
 #define KEYBOARD_BUFFER_SIZE 128
 static uint8_t keyboard_buffer[KEYBOARD_BUFFER_SIZE];
-static uint32_t keyboard_buffer_start = 0;
-static uint32_t keyboard_buffer_end = 0;
+static ring_t keyboard_ring = RING_INIT(keyboard_buffer, KEYBOARD_BUFFER_SIZE, 1);
 
 // Scancode set 1 to ASCII conversion table (US QWERTY)
 static const char kbdus[128] = {
@@ -112,11 +113,9 @@ void keyboard_handler(void) {
                 keyboard_modifiers ^= MOD_SCROLL;
                 break;
             default:
-                // Add the scancode to the buffer if there's space
-                if (((keyboard_buffer_end + 1) % KEYBOARD_BUFFER_SIZE) != keyboard_buffer_start) {
-                    keyboard_buffer[keyboard_buffer_end] = scancode;
-                    keyboard_buffer_end = (keyboard_buffer_end + 1) % KEYBOARD_BUFFER_SIZE;
-                }
+                // Add the scancode to the buffer; when it is full the key is
+                // dropped and counted
+                ring_push(&keyboard_ring, &scancode);
                 break;
         }
     }
@@ -145,8 +144,9 @@ char keyboard_scancode_to_ascii(uint8_t scancode) {
 bool keyboard_is_key_pressed(uint8_t scancode) {
     // This is a simplified version - in a real implementation, you'd track the state of each key
     // For now, we'll just check if the key is in the buffer
-    for (uint32_t i = keyboard_buffer_start; i != keyboard_buffer_end; i = (i + 1) % KEYBOARD_BUFFER_SIZE) {
-        if (keyboard_buffer[i] == scancode) {
+    uint8_t queued;
+    for (uint32_t i = 0; ring_peek(&keyboard_ring, i, &queued); i++) {
+        if (queued == scancode) {
             return true;
         }
     }
@@ -155,29 +155,31 @@ bool keyboard_is_key_pressed(uint8_t scancode) {
 
 // Get a character from the keyboard buffer (blocking)
 char keyboard_getchar(void) {
-    while (keyboard_buffer_start == keyboard_buffer_end) {
-        // Wait for a key to be pressed
-        asm volatile ("hlt");
+    uint8_t scancode;
+    while (!ring_pop(&keyboard_ring, &scancode)) {
+        // Wait for a key to be pressed, zeroing pages for the pool meanwhile
+        if (!zpool_refill()) {
+            asm volatile ("hlt");
+        }
     }
     
-    uint8_t scancode = keyboard_buffer[keyboard_buffer_start];
-    keyboard_buffer_start = (keyboard_buffer_start + 1) % KEYBOARD_BUFFER_SIZE;
-    
     return keyboard_scancode_to_ascii(scancode);
 }
 
 // Get a scancode from the keyboard buffer (non-blocking)
 uint16_t keyboard_get_scancode(void) {
-    if (keyboard_buffer_start == keyboard_buffer_end) {
+    uint8_t scancode;
+    if (!ring_pop(&keyboard_ring, &scancode)) {
         return 0;
     }
     
-    uint8_t scancode = keyboard_buffer[keyboard_buffer_start];
-    keyboard_buffer_start = (keyboard_buffer_start + 1) % KEYBOARD_BUFFER_SIZE;
-    
     return scancode;
 }
 
+const ring_t *keyboard_get_ring(void) {
+    return &keyboard_ring;
+}
+
 void keyboard_reset(void) {
     keyboard_initialized = false;
 }
@@ -192,8 +194,7 @@ void keyboard_init(void) {
     asm volatile ("cli");
     
     // Clear the keyboard buffer
-    keyboard_buffer_start = 0;
-    keyboard_buffer_end = 0;
+    ring_flush(&keyboard_ring);
     
     // Enable the first PS/2 port
     keyboard_send_command(0xAE);
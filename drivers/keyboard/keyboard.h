@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 #include <stdbool.h>
+#include "../../kernel/ring.h"
 
 // Keyboard controller ports
 #define KEYBOARD_DATA_PORT    0x60
@@ -159,4 +160,7 @@ uint16_t keyboard_get_scancode(void);
 bool keyboard_is_key_pressed(uint8_t scancode);
 char keyboard_scancode_to_ascii(uint8_t scancode);
 
+// Scancode buffer, for its drop and fill counters
+const ring_t *keyboard_get_ring(void);
+
 #endif // KEYBOARD_H
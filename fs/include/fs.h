@@ -67,10 +67,21 @@ fs_node_t *finddir_fs(fs_node_t *node, char *name);
 // Helper functions
 fs_node_t *make_file(char *name, uint32_t flags, uint32_t size);
 fs_node_t *make_dir(char *name, uint32_t flags);
+void free_node(fs_node_t *node);
 
 // Initrd initialization
 fs_node_t *initrd_initialize(uint32_t location);
 
+// Initrd file checksums, verified on each file's first read
+typedef struct {
+    uint32_t files_checked;
+    uint32_t files_bad;
+    uint32_t bytes_checked;
+    uint32_t cycles;            // TSC cycles spent checking, 0 without a TSC
+} initrd_stats_t;
+
+const initrd_stats_t *initrd_get_stats(void);
+
 // SkullFS functions
 fs_node_t *skullfs_init(void);
 fs_node_t *skullfs_create_file(fs_node_t *parent_dir, const char *name);
@@ -1,10 +1,23 @@
 #include "../include/fs.h"
 #include <string.h>
 #include "../../kernel/memory.h"  // Memory management functions (kmalloc, kfree)
+#include "../../kernel/slab.h"
 
 // The root of the filesystem
 fs_node_t *fs_root = 0;
 
+// Object cache for VFS nodes
+static kmem_cache_t *node_cache = 0;
+
+// Allocate a node from the VFS node cache
+static fs_node_t *alloc_node(void) {
+    if (!node_cache) {
+        node_cache = kmem_cache_create("fs_node", sizeof(fs_node_t), SLAB_HWCACHE_ALIGN, 0);
+        if (!node_cache) return 0;
+    }
+    return (fs_node_t*)kmem_cache_alloc(node_cache);
+}
+
 // Default file operations
 static uint32_t fs_read(fs_node_t *node, uint32_t offset, uint32_t size, uint8_t *buffer) {
     // Check if the node has a specific read function
@@ -85,7 +98,7 @@ fs_node_t *finddir_fs(fs_node_t *node, char *name) {
 
 // Helper function to create a new file node
 fs_node_t *make_file(char *name, uint32_t flags, uint32_t size) {
-    fs_node_t *node = (fs_node_t*)kmalloc(sizeof(fs_node_t));
+    fs_node_t *node = alloc_node();
     if (!node) return 0;
     
     strncpy(node->name, name, 127);
@@ -113,7 +126,7 @@ fs_node_t *make_file(char *name, uint32_t flags, uint32_t size) {
 
 // Helper function to create a new directory node
 fs_node_t *make_dir(char *name, uint32_t flags) {
-    fs_node_t *node = (fs_node_t*)kmalloc(sizeof(fs_node_t));
+    fs_node_t *node = alloc_node();
     if (!node) return 0;
     
     strncpy(node->name, name, 127);
@@ -139,6 +152,12 @@ fs_node_t *make_dir(char *name, uint32_t flags) {
     return node;
 }
 
+// Free a node created by make_file() or make_dir()
+void free_node(fs_node_t *node) {
+    if (!node) return;
+    kmem_cache_free(node_cache, node);
+}
+
 // Initialize the filesystem
 void fs_init() {
     // Create the root directory
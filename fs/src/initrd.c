@@ -1,35 +1,95 @@
 #include "fs.h"
 #include <string.h>
 #include "kernel/memory.h"
+#include "kernel/pmm.h"
+#include "kernel/cpu.h"
+#include "kernel/util.h"
+#include "kernel/hash.h"
+#include "kernel/printf.h"
 
 // Simple initrd file header
+// Layout: this header, `nheaders` file headers, then the file data. All
+// offsets are from the start of the image. tools/geninitrd.c writes it.
 struct initrd_file_header {
-    char magic[8];      // "INITRD\0\0"
-    uint32_t nheaders;   // Number of file headers
+    char magic[6];      // "INITRD"
+    uint8_t version;    // INITRD_VERSION
+    uint8_t hash;       // INITRD_HASH_* used for every checksum
+    uint32_t nheaders;  // Number of file headers
+    uint32_t size;      // Bytes in the whole image
+    uint32_t checksum;  // Of the file headers
 } __attribute__((packed));
 
 struct initrd_file_headers {
     char name[64];      // Filename
     uint32_t offset;    // Offset in the initrd
     uint32_t length;    // Length of the file
+    uint32_t checksum;  // Of the file data
 } __attribute__((packed));
 
+#define INITRD_VERSION     2
+#define INITRD_HASH_CRC32C 1
+#define INITRD_HASH_XXH32  2
+
+// File checksums are checked on the first read
+#define CHECK_PENDING 0
+#define CHECK_GOOD    1
+#define CHECK_BAD     2
+
 // Global variables
 static uint32_t nheaders = 0;
 static struct initrd_file_headers *file_headers = 0;
-static uint8_t *initrd_start = 0;
+static uint8_t *initrd_base = 0;
+static uint8_t hash_type = 0;
+static fs_node_t **file_nodes = 0;  // One node per file, created on first lookup
+static uint8_t *file_checks = 0;    // CHECK_* per file
+static initrd_stats_t stats;
+
+static uint32_t initrd_checksum(const void *data, uint32_t len) {
+    if (hash_type == INITRD_HASH_XXH32) {
+        return xxhash32(data, len, 0);
+    }
+    return crc32c(0, data, len);
+}
+
+// Check a file's data against its checksum once; false when it does not
+// match, now or on an earlier read
+static bool initrd_verify(uint32_t index) {
+    if (file_checks[index] == CHECK_PENDING) {
+        struct initrd_file_headers *file = &file_headers[index];
+        bool tsc = cpu_get_info()->has_tsc;
+        uint64_t start = tsc ? rdtsc() : 0;
+
+        bool good = initrd_checksum(initrd_base + file->offset, file->length) == file->checksum;
+        file_checks[index] = good ? CHECK_GOOD : CHECK_BAD;
+
+        stats.files_checked++;
+        stats.bytes_checked += file->length;
+        if (tsc) {
+            stats.cycles += (uint32_t)(rdtsc() - start);
+        }
+        if (!good) {
+            stats.files_bad++;
+            kprintf("initrd: checksum mismatch in %s\n", file->name);
+        }
+    }
+    return file_checks[index] == CHECK_GOOD;
+}
 
 // Read a file from the initrd.
 static uint32_t initrd_read(fs_node_t *node, uint32_t offset, uint32_t size, uint8_t *buffer) {
     if (offset >= node->length) {
         return 0;  // EOF
     }
-    
+
+    if (!initrd_verify(node->impl)) {
+        return 0;
+    }
+
     if (offset + size > node->length) {
         size = node->length - offset;
     }
-    
-    memcpy(buffer, initrd_start + node->inode + offset, size);
+
+    memcpy(buffer, initrd_base + node->inode + offset, size);
     return size;
 }
 
@@ -50,34 +110,89 @@ static fs_node_t *initrd_finddir(fs_node_t *node, char *name) {
     (void)node;
     for (uint32_t i = 0; i < nheaders; i++) {
         if (strcmp(name, file_headers[i].name) == 0) {
-            fs_node_t *file = make_file(file_headers[i].name, 0, file_headers[i].length);
-            file->inode = file_headers[i].offset;
-            file->read = initrd_read;
-            return file;
+            if (!file_nodes[i]) {
+                fs_node_t *file = make_file(file_headers[i].name, 0, file_headers[i].length);
+                if (!file) return 0;
+                file->inode = file_headers[i].offset;
+                file->impl = i;
+                file->read = initrd_read;
+                file_nodes[i] = file;
+            }
+            return file_nodes[i];
         }
     }
     return 0;
 }
 
+// Check that the headers describe an image that fits the initrd window:
+// everything they point at must lie inside `size` bytes
+static bool initrd_check_layout(struct initrd_file_header *header) {
+    if (header->size > INITRD_MAX_SIZE || header->size < sizeof(*header)) {
+        return false;
+    }
+
+    uint32_t room = (header->size - sizeof(*header)) / sizeof(struct initrd_file_headers);
+    if (header->nheaders > room) {
+        return false;
+    }
+
+    uint32_t data_start = sizeof(*header) + header->nheaders * sizeof(struct initrd_file_headers);
+    for (uint32_t i = 0; i < header->nheaders; i++) {
+        struct initrd_file_headers *file = &file_headers[i];
+        if (!memchr(file->name, '\0', sizeof(file->name))) {
+            return false;
+        }
+        if (file->offset < data_start || file->offset > header->size ||
+            file->length > header->size - file->offset) {
+            return false;
+        }
+    }
+    return true;
+}
 
 // Initialize the initial ramdisk.
 fs_node_t *initrd_initialize(uint32_t location) {
     struct initrd_file_header *header = (struct initrd_file_header*)location;
-    
+
     // Verify the magic number
-    if (strncmp(header->magic, "INITRD", 6) != 0) {
+    if (memcmp(header->magic, "INITRD", 6) != 0) {
         return 0;  // Invalid initrd
     }
-    
+    if (header->version != INITRD_VERSION ||
+        (header->hash != INITRD_HASH_CRC32C && header->hash != INITRD_HASH_XXH32)) {
+        kprintf("initrd: unsupported format version %u\n", header->version);
+        return 0;
+    }
+
+    hash_type = header->hash;
     nheaders = header->nheaders;
     file_headers = (struct initrd_file_headers*)(location + sizeof(struct initrd_file_header));
-    initrd_start = (uint8_t*)(location + sizeof(struct initrd_file_header) + 
-                             sizeof(struct initrd_file_headers) * nheaders);
-    
+    initrd_base = (uint8_t*)location;
+
+    if (!initrd_check_layout(header) ||
+        initrd_checksum(file_headers, nheaders * sizeof(struct initrd_file_headers)) != header->checksum) {
+        kprintf("initrd: corrupt or truncated image\n");
+        nheaders = 0;
+        return 0;
+    }
+
+    // One allocation for the node table and the check states
+    file_nodes = (fs_node_t**)kmalloc((sizeof(fs_node_t*) + 1) * nheaders);
+    if (!file_nodes) {
+        return 0;
+    }
+    memset(file_nodes, 0, (sizeof(fs_node_t*) + 1) * nheaders);
+    file_checks = (uint8_t*)(file_nodes + nheaders);
+    memset(&stats, 0, sizeof(stats));
+
     // Create the root directory
     fs_node_t *root = make_dir("initrd", 0);
     root->readdir = initrd_readdir;
     root->finddir = initrd_finddir;
-    
+
     return root;
 }
+
+const initrd_stats_t *initrd_get_stats(void) {
+    return &stats;
+}
@@ -1,6 +1,7 @@
 #include "../include/fs.h"
 #include <string.h>
 #include "../../kernel/memory.h"
+#include "../../kernel/slab.h"
 
 // SkullFS - A simple in-memory filesystem
 
@@ -28,6 +29,9 @@ typedef struct skullfs_dir {
 // Global inode counter
 static uint32_t next_inode = 1;
 
+// Object cache for directory entries
+static kmem_cache_t *dir_entry_cache = 0;
+
 // Allocate file data
 static file_data_t* allocate_file_data(uint32_t initial_size) {
     file_data_t *fd = (file_data_t*)kmalloc(sizeof(file_data_t));
@@ -56,14 +60,10 @@ static int resize_file_data(file_data_t *fd, uint32_t new_size) {
         new_capacity *= 2;
     }
     
-    uint8_t *new_data = (uint8_t*)kmalloc(new_capacity);
+    // Grows in place when the heap has room after the buffer
+    uint8_t *new_data = (uint8_t*)krealloc(fd->data, new_capacity);
     if (!new_data) return 0;
     
-    // Copy old data
-    memcpy(new_data, fd->data, fd->size);
-    
-    // Free old data and update
-    kfree(fd->data);
     fd->data = new_data;
     fd->capacity = new_capacity;
     
@@ -202,7 +202,7 @@ static int skullfs_add_entry(skullfs_dir_t *dir, const char *name, fs_node_t *no
     }
     
     // Create new entry
-    dir_entry_t *new_entry = (dir_entry_t*)kmalloc(sizeof(dir_entry_t));
+    dir_entry_t *new_entry = (dir_entry_t*)kmem_cache_alloc(dir_entry_cache);
     if (!new_entry) return 0;
     
     strncpy(new_entry->name, name, 127);
@@ -229,7 +229,7 @@ static int skullfs_remove_entry(skullfs_dir_t *dir, const char *name) {
             } else {
                 dir->entries = entry->next;
             }
-            kfree(entry);
+            kmem_cache_free(dir_entry_cache, entry);
             dir->num_entries--;
             return 1;
         }
@@ -268,7 +268,7 @@ fs_node_t *skullfs_create_file(fs_node_t *parent_dir, const char *name) {
     
     // Add to directory
     if (!skullfs_add_entry(dir, name, file)) {
-        kfree(file);
+        free_node(file);
         return 0;
     }
     
@@ -303,7 +303,7 @@ fs_node_t *skullfs_create_dir(fs_node_t *parent_dir, const char *name) {
     // Allocate directory structure
     skullfs_dir_t *new_dir_struct = (skullfs_dir_t*)kmalloc(sizeof(skullfs_dir_t));
     if (!new_dir_struct) {
-        kfree(new_dir);
+        free_node(new_dir);
         return 0;
     }
     
@@ -315,7 +315,7 @@ fs_node_t *skullfs_create_dir(fs_node_t *parent_dir, const char *name) {
     // Add to parent directory
     if (!skullfs_add_entry(dir, name, new_dir)) {
         kfree(new_dir_struct);
-        kfree(new_dir);
+        free_node(new_dir);
         return 0;
     }
     
@@ -346,7 +346,7 @@ int skullfs_delete(fs_node_t *parent_dir, const char *name) {
             dir_entry_t *entry = node_dir->entries;
             while (entry) {
                 dir_entry_t *next = entry->next;
-                kfree(entry);
+                kmem_cache_free(dir_entry_cache, entry);
                 entry = next;
             }
             kfree(node_dir);
@@ -363,13 +363,18 @@ int skullfs_delete(fs_node_t *parent_dir, const char *name) {
     skullfs_remove_entry(dir, name);
     
     // Free the node
-    kfree(node);
+    free_node(node);
     
     return 1;
 }
 
 // Initialize SkullFS root
 fs_node_t *skullfs_init() {
+    if (!dir_entry_cache) {
+        dir_entry_cache = kmem_cache_create("dir_entry", sizeof(dir_entry_t), SLAB_HWCACHE_ALIGN, 0);
+        if (!dir_entry_cache) return 0;
+    }
+
     // Create root directory
     fs_node_t *root = make_dir("/", 0);
     if (!root) return 0;
@@ -381,7 +386,7 @@ fs_node_t *skullfs_init() {
     // Allocate root directory structure
     skullfs_dir_t *root_dir = (skullfs_dir_t*)kmalloc(sizeof(skullfs_dir_t));
     if (!root_dir) {
-        kfree(root);
+        free_node(root);
         return 0;
     }
     
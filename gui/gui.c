@@ -6,33 +6,7 @@
 #include "../kernel/cpu.h"
 #include <string.h>
 #include "../kernel/memory.h"
-
-// Helper function to format time with leading zeros
-static void format_time_str(char* str, uint8_t hour, uint8_t minute, uint8_t second) {
-    char hour_str[3];
-    char min_str[3];
-    char sec_str[3];
-    
-    itoa(hour, hour_str, 10);
-    itoa(minute, min_str, 10);
-    itoa(second, sec_str, 10);
-    
-    str[0] = '\0';
-    if (hour < 10) {
-        strcat(str, "0");
-    }
-    strcat(str, hour_str);
-    strcat(str, ":");
-    if (minute < 10) {
-        strcat(str, "0");
-    }
-    strcat(str, min_str);
-    strcat(str, ":");
-    if (second < 10) {
-        strcat(str, "0");
-    }
-    strcat(str, sec_str);
-}
+#include "../kernel/printf.h"
 
 // Draw the title bar
 static void gui_draw_title_bar() {
@@ -59,23 +33,9 @@ static void gui_draw_hline(int y) {
 }
 
 void gui_draw_memory() {
-    size_t free_mem = get_free_memory() / 1024;
-    size_t used_mem = get_used_memory() / 1024;
-    size_t total_mem = get_total_memory() / 1024;
-    
     char mem_str[48];
-    char free_val[10], used_val[10], total_val[10];
-    
-    itoa(free_mem, free_val, 10);
-    itoa(used_mem, used_val, 10);
-    itoa(total_mem, total_val, 10);
-    
-    mem_str[0] = '\0';
-    strcat(mem_str, "Mem: ");
-    strcat(mem_str, free_val);
-    strcat(mem_str, "/");
-    strcat(mem_str, total_val);
-    strcat(mem_str, " KB free");
+    ksnprintf(mem_str, sizeof(mem_str), "Mem: %u/%u KB free",
+              get_free_memory() / 1024, get_total_memory() / 1024);
     
     // Clear the line first
     vga_manager_fullscreen_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
@@ -97,22 +57,8 @@ void gui_draw_uptime() {
     uint32_t seconds = uptime % 60;
     
     char uptime_str[32];
-    char hour_str[10], min_str[10], sec_str[10];
-    
-    itoa(hours, hour_str, 10);
-    itoa(minutes, min_str, 10);
-    itoa(seconds, sec_str, 10);
-    
-    uptime_str[0] = '\0';
-    strcat(uptime_str, "Uptime: ");
-    if (hours < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, hour_str);
-    strcat(uptime_str, ":");
-    if (minutes < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, min_str);
-    strcat(uptime_str, ":");
-    if (seconds < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, sec_str);
+    ksnprintf(uptime_str, sizeof(uptime_str), "Uptime: %02u:%02u:%02u",
+              hours, minutes, seconds);
     
     // Clear the line first
     vga_manager_fullscreen_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLUE);
@@ -131,19 +77,8 @@ void gui_draw_cpu_info() {
     cpu_info_t* cpu = cpu_get_info();
     char cpu_str[48];
     
-    cpu_str[0] = '\0';
-    strcat(cpu_str, "CPU: ");
-    
     // Truncate vendor string if too long
-    char vendor_display[20];
-    int vendor_len = strlen(cpu->vendor);
-    if (vendor_len > 15) {
-        strncpy(vendor_display, cpu->vendor, 15);
-        vendor_display[15] = '\0';
-    } else {
-        strcpy(vendor_display, cpu->vendor);
-    }
-    strcat(cpu_str, vendor_display);
+    ksnprintf(cpu_str, sizeof(cpu_str), "CPU: %.15s", cpu->vendor);
     
     // Clear the line first
     vga_manager_fullscreen_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
@@ -163,7 +98,8 @@ void gui_draw_time() {
     rtc_get_time(&time);
     
     char time_str[16];
-    format_time_str(time_str, time.hour, time.minute, time.second);
+    ksnprintf(time_str, sizeof(time_str), "%02u:%02u:%02u",
+              time.hour, time.minute, time.second);
     
     // Clear the line first
     vga_manager_fullscreen_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
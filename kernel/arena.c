@@ -0,0 +1,112 @@
+#include "arena.h"
+#include "kernel.h"
+#include "memory.h"
+
+// Arena allocator
+// The arena header and its first chunk are a single kmalloc() block. When a
+// request does not fit, a new chunk at least as large as the first one is
+// pushed onto the chunk list and becomes the current one, so a reset only
+// has work to do for arenas that overflowed.
+
+#define ARENA_ALIGN 8
+
+typedef struct arena_chunk {
+    struct arena_chunk *next;
+    size_t size;            // Usable bytes after the header
+} arena_chunk_t;
+
+struct arena {
+    arena_chunk_t *chunks;  // Current chunk first; the embedded one last
+    char *ptr;              // Next free byte in the current chunk
+    char *end;
+    size_t used;            // Bytes handed out since the last reset
+    arena_chunk_t first;
+};
+
+static inline size_t align_up(size_t size) {
+    return (size + ARENA_ALIGN - 1) & ~(size_t)(ARENA_ALIGN - 1);
+}
+
+static inline char *chunk_data(arena_chunk_t *chunk) {
+    return (char*)align_up((size_t)(chunk + 1));
+}
+
+static void arena_use_chunk(arena_t *arena, arena_chunk_t *chunk) {
+    arena->ptr = chunk_data(chunk);
+    arena->end = (char*)(chunk + 1) + chunk->size;
+}
+
+// Create an arena
+arena_t *arena_create(size_t size) {
+    size = align_up(size) + ARENA_ALIGN;
+    arena_t *arena = (arena_t*)kmalloc(sizeof(arena_t) + size);
+    if (!arena) return NULL;
+
+    arena->first.next = NULL;
+    arena->first.size = size;
+    arena->chunks = &arena->first;
+    arena->used = 0;
+    arena_use_chunk(arena, &arena->first);
+    return arena;
+}
+
+// Allocate from the arena
+void *arena_alloc(arena_t *arena, size_t size) {
+    if (!arena) return NULL;
+
+    size = align_up(size ? size : 1);
+    if (size > (size_t)(arena->end - arena->ptr)) {
+        size_t chunk_size = size + ARENA_ALIGN;
+        if (chunk_size < arena->first.size) {
+            chunk_size = arena->first.size;
+        }
+
+        arena_chunk_t *chunk = (arena_chunk_t*)kmalloc(sizeof(arena_chunk_t) + chunk_size);
+        if (!chunk) return NULL;
+
+        chunk->size = chunk_size;
+        chunk->next = arena->chunks;
+        arena->chunks = chunk;
+        arena_use_chunk(arena, chunk);
+    }
+
+    void *ptr = arena->ptr;
+    arena->ptr += size;
+    arena->used += size;
+    return ptr;
+}
+
+// Copy a string into the arena
+char *arena_strdup(arena_t *arena, const char *str) {
+    size_t len = strlen(str) + 1;
+    char *copy = (char*)arena_alloc(arena, len);
+    if (copy) {
+        memcpy(copy, str, len);
+    }
+    return copy;
+}
+
+// Release everything allocated from the arena
+void arena_reset(arena_t *arena) {
+    if (!arena) return;
+
+    while (arena->chunks != &arena->first) {
+        arena_chunk_t *chunk = arena->chunks;
+        arena->chunks = chunk->next;
+        kfree(chunk);
+    }
+    arena->used = 0;
+    arena_use_chunk(arena, &arena->first);
+}
+
+// Free the arena
+void arena_destroy(arena_t *arena) {
+    if (!arena) return;
+
+    arena_reset(arena);
+    kfree(arena);
+}
+
+size_t arena_used(arena_t *arena) {
+    return arena ? arena->used : 0;
+}
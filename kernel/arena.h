@@ -0,0 +1,33 @@
+#ifndef KERNEL_ARENA_H
+#define KERNEL_ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Bump-pointer arenas for short-lived allocations
+// Allocations are carved from one chunk in address order and are never
+// freed individually; arena_reset() releases all of them at once.
+
+typedef struct arena arena_t;
+
+// Create an arena whose first chunk holds `size` bytes, or NULL when out
+// of memory. Allocations that do not fit spill into extra chunks.
+arena_t *arena_create(size_t size);
+
+// Allocate `size` bytes aligned to 8, or NULL when out of memory
+void *arena_alloc(arena_t *arena, size_t size);
+
+// Copy a string into the arena
+char *arena_strdup(arena_t *arena, const char *str);
+
+// Release everything allocated from the arena. Extra chunks go back to the
+// heap; the first chunk is kept for the next round.
+void arena_reset(arena_t *arena);
+
+// Free the arena and all of its chunks
+void arena_destroy(arena_t *arena);
+
+// Bytes handed out since the last reset
+size_t arena_used(arena_t *arena);
+
+#endif // KERNEL_ARENA_H
@@ -1,5 +1,6 @@
 #include "cpu.h"
 #include "kernel.h"
+#include "hash.h"
 #include <string.h>
 
 static cpu_info_t cpu_info;
@@ -27,15 +28,29 @@ static bool cpu_has_cpuid(void) {
     return (eflags & (1 << 21)) != 0;
 }
 
-// Execute CPUID instruction
+// Execute CPUID instruction (subleaf 0)
 static void cpuid(uint32_t eax, uint32_t* eax_out, uint32_t* ebx_out, uint32_t* ecx_out, uint32_t* edx_out) {
     asm volatile (
         "cpuid"
         : "=a" (*eax_out), "=b" (*ebx_out), "=c" (*ecx_out), "=d" (*edx_out)
-        : "a" (eax)
+        : "a" (eax), "c" (0)
     );
 }
 
+// Let SSE instructions run: clear CR0.EM, set CR0.MP, and announce FXSAVE
+// and SIMD exception support in CR4
+static void cpu_enable_sse(void) {
+    uint32_t cr0, cr4;
+    asm volatile ("mov %%cr0, %0" : "=r"(cr0));
+    cr0 &= ~(1 << 2);   // EM
+    cr0 |= (1 << 1);    // MP
+    asm volatile ("mov %0, %%cr0" : : "r"(cr0));
+
+    asm volatile ("mov %%cr4, %0" : "=r"(cr4));
+    cr4 |= (1 << 9) | (1 << 10);    // OSFXSR, OSXMMEXCPT
+    asm volatile ("mov %0, %%cr4" : : "r"(cr4));
+}
+
 // Initialize CPU detection
 void cpu_init(void) {
     memset(&cpu_info, 0, sizeof(cpu_info));
@@ -47,6 +62,7 @@ void cpu_init(void) {
         
         // Get vendor string
         cpuid(0, &eax, &ebx, &ecx, &edx);
+        uint32_t max_leaf = eax;
         
         // Extract vendor string (12 bytes)
         uint32_t vendor[4] = {ebx, edx, ecx, 0};
@@ -59,10 +75,39 @@ void cpu_init(void) {
         cpu_info.has_mmx = (edx & (1 << 23)) != 0;
         cpu_info.has_sse = (edx & (1 << 25)) != 0;
         cpu_info.has_sse2 = (edx & (1 << 26)) != 0;
+        cpu_info.has_pse = (edx & (1 << 3)) != 0;
+        cpu_info.has_pge = (edx & (1 << 13)) != 0;
+        cpu_info.has_fxsr = (edx & (1 << 24)) != 0;
+        cpu_info.has_tsc = (edx & (1 << 4)) != 0;
+        cpu_info.has_sse42 = (ecx & (1 << 20)) != 0;
+
+        // SSE needs FXSAVE support to be enabled
+        if (cpu_info.has_sse && cpu_info.has_fxsr) {
+            cpu_enable_sse();
+        } else {
+            cpu_info.has_sse = false;
+            cpu_info.has_sse2 = false;
+            cpu_info.has_sse42 = false;
+        }
+
+        // Structured extended features
+        if (max_leaf >= 7) {
+            cpuid(7, &eax, &ebx, &ecx, &edx);
+            cpu_info.has_erms = (ebx & (1 << 9)) != 0;
+        }
+
+        // Pick memcpy/memset for this CPU
+        int features = 0;
+        if (cpu_info.has_erms) features |= STRING_ERMS;
+        if (cpu_info.has_sse2) features |= STRING_SSE2;
+        string_init(features);
     } else {
         // Fallback if CPUID not available
         strcpy(cpu_info.vendor, "Unknown");
     }
+
+    // CRC32C on the crc32 instruction when there is one
+    hash_init(cpu_info.has_sse42);
 }
 
 cpu_info_t* cpu_get_info(void) {
@@ -7,9 +7,15 @@
 typedef struct {
     char vendor[13];
     bool has_cpuid;
-    bool has_sse;
+    bool has_sse;       // SSE is usable: set only once enabled in CR4
     bool has_sse2;
+    bool has_fxsr;
     bool has_mmx;
+    bool has_pse;       // 4 MB pages
+    bool has_pge;       // Global pages
+    bool has_erms;      // Enhanced rep movsb/stosb
+    bool has_sse42;     // SSE4.2, for the crc32 instruction
+    bool has_tsc;       // Time stamp counter (rdtsc)
 } cpu_info_t;
 
 void cpu_init(void);
@@ -0,0 +1,98 @@
+#include "dma.h"
+#include "kernel.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "shrinker.h"
+#include "util.h"
+
+// DMA buffer allocator
+// Buffers are buddy blocks; the zone limit is enforced by searching the free
+// lists for a block low enough. Bounce buffers are taken at boot, before the
+// rest of the kernel has used up low memory.
+
+static void *bounce_buffers[DMA_BOUNCE_COUNT];
+static uint32_t num_bounce = 0;
+static uint32_t bounce_busy = 0;    // Bitmask of buffers handed out
+
+static inline bool is_power_of_two(uint32_t value) {
+    return (value & (value - 1)) == 0;
+}
+
+// Allocate a physically contiguous buffer
+void *dma_alloc(size_t size, uint32_t align, uint32_t boundary, uint32_t limit, uint32_t *phys) {
+    if (size == 0 || !is_power_of_two(align) || !is_power_of_two(boundary)) {
+        return NULL;
+    }
+
+    // A block aligned to its size starts on a boundary, so the buffer only
+    // crosses one if it is larger than the boundary
+    if (boundary && size > boundary) {
+        return NULL;
+    }
+
+    size_t span = size > align ? size : align;
+    uint32_t order = pmm_order_for_size(span);
+    if (((size_t)PAGE_SIZE << order) < span) {
+        return NULL;
+    }
+
+    uint32_t addr = limit ? pmm_alloc_pages_below(order, limit) : pmm_alloc_pages(order);
+    if (!addr && shrink_memory((size_t)PAGE_SIZE << order)) {
+        addr = limit ? pmm_alloc_pages_below(order, limit) : pmm_alloc_pages(order);
+    }
+    if (!addr) return NULL;
+
+    if (phys) {
+        *phys = addr;
+    }
+    return PHYS_TO_VIRT(addr);
+}
+
+// Free a buffer returned by dma_alloc()
+void dma_free(void *virt) {
+    if (!virt) return;
+    pmm_free_pages(VIRT_TO_PHYS(virt));
+}
+
+// Reserve the bounce buffers
+void dma_init(void) {
+    num_bounce = 0;
+    bounce_busy = 0;
+
+    while (num_bounce < DMA_BOUNCE_COUNT) {
+        void *buffer = dma_alloc(DMA_BOUNCE_SIZE, DMA_BOUNCE_SIZE, DMA_BOUNCE_SIZE,
+                                 DMA_LIMIT_ISA, NULL);
+        if (!buffer) break;
+        bounce_buffers[num_bounce++] = buffer;
+    }
+}
+
+// Take a free bounce buffer. Interrupts are off around `bounce_busy`, as a
+// completion handler may return a buffer at any time.
+void *dma_bounce_get(uint32_t *phys) {
+    uint32_t flags = irq_save();
+    for (uint32_t i = 0; i < num_bounce; i++) {
+        if (!(bounce_busy & (1U << i))) {
+            bounce_busy |= 1U << i;
+            irq_restore(flags);
+            if (phys) {
+                *phys = VIRT_TO_PHYS(bounce_buffers[i]);
+            }
+            return bounce_buffers[i];
+        }
+    }
+    irq_restore(flags);
+    return NULL;
+}
+
+// Return a bounce buffer
+void dma_bounce_put(void *virt) {
+    for (uint32_t i = 0; i < num_bounce; i++) {
+        if (bounce_buffers[i] == virt) {
+            uint32_t flags = irq_save();
+            bounce_busy &= ~(1U << i);
+            irq_restore(flags);
+            return;
+        }
+    }
+}
@@ -0,0 +1,39 @@
+#ifndef KERNEL_DMA_H
+#define KERNEL_DMA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Buffers for device DMA
+// DMA memory is physically contiguous and comes from the page frame
+// allocator in power-of-two blocks aligned to their size, so a buffer never
+// crosses a boundary as large as itself.
+
+// Highest physical address a buffer may reach
+#define DMA_LIMIT_ISA  0x1000000    // ISA DMA only reaches the first 16 MB
+#define DMA_LIMIT_NONE 0            // Anywhere in the direct map
+
+// Bounce buffers for ISA DMA, reserved at boot: below 16 MB and 64 KB
+// aligned, so a transfer never crosses a 64 KB boundary
+#define DMA_BOUNCE_SIZE  0x10000
+#define DMA_BOUNCE_COUNT 4
+
+// Reserve the bounce buffers
+void dma_init(void);
+
+// Allocate `size` bytes of physically contiguous memory below `limit`,
+// aligned to `align` and not crossing a multiple of `boundary` (0 for none);
+// both must be powers of two. Returns the virtual address and stores the
+// physical address in `phys`, or returns NULL.
+void *dma_alloc(size_t size, uint32_t align, uint32_t boundary, uint32_t limit, uint32_t *phys);
+
+// Free a buffer returned by dma_alloc()
+void dma_free(void *virt);
+
+// Take a bounce buffer of DMA_BOUNCE_SIZE bytes, or NULL when all are in use
+void *dma_bounce_get(uint32_t *phys);
+
+// Return a bounce buffer
+void dma_bounce_put(void *virt);
+
+#endif // KERNEL_DMA_H
@@ -0,0 +1,60 @@
+; Kernel entry point
+; boot.asm jumps here at physical address 0x8000 with paging off. The kernel
+; is linked at KERNEL_VIRTUAL_BASE + 0x8000, so enable paging with a boot
+; page directory that maps the first 4 MB both at 0 and at
+; KERNEL_VIRTUAL_BASE, then continue in the higher half. vmm_init() later
+; replaces this directory and drops the identity map.
+[bits 32]
+
+KERNEL_VIRTUAL_BASE equ 0xC0000000
+KERNEL_PDE          equ KERNEL_VIRTUAL_BASE >> 22
+
+PDE_4MB_KERNEL      equ 0x83        ; Present, writable, 4 MB page
+CR4_PSE             equ 0x10
+CR0_PG              equ 0x80000000
+
+extern kernel_entry
+
+section .text.entry
+global _start
+_start:
+    ; Until paging is on, symbols must be used by their physical address
+    mov eax, cr4
+    or eax, CR4_PSE
+    mov cr4, eax
+
+    mov eax, boot_page_directory - KERNEL_VIRTUAL_BASE
+    mov cr3, eax
+
+    mov eax, cr0
+    or eax, CR0_PG
+    mov cr0, eax
+
+    ; Absolute jump into the higher half
+    mov eax, higher_half
+    jmp eax
+
+higher_half:
+    ; Use the higher-half aliases of the boot stack and the boot sector GDT
+    add esp, KERNEL_VIRTUAL_BASE
+    sub esp, 8
+    sgdt [esp]
+    add dword [esp + 2], KERNEL_VIRTUAL_BASE
+    lgdt [esp]
+    add esp, 8
+
+    call kernel_entry
+
+    ; kernel_entry() never returns
+.hang:
+    cli
+    hlt
+    jmp .hang
+
+section .data
+align 4096
+boot_page_directory:
+    dd PDE_4MB_KERNEL                   ; 0x00000000 -> 0 (identity)
+    times KERNEL_PDE - 1 dd 0
+    dd PDE_4MB_KERNEL                   ; KERNEL_VIRTUAL_BASE -> 0
+    times 1023 - KERNEL_PDE dd 0
@@ -3,6 +3,11 @@
 #include "string.h"
 #include "shell.h"
 #include "util.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "timer.h"
+#include "printf.h"
+#include "cpu.h"
 
 // Global root filesystem node
 extern fs_node_t *fs_root;
@@ -162,7 +167,7 @@ static fs_node_t *create_minimal_fs() {
 // Initialize the filesystem
 void fs_initialize() {
     // Try to mount the initial ramdisk as root
-    fs_root = initrd_initialize(0x20000);
+    fs_root = initrd_initialize((uint32_t)PHYS_TO_VIRT(INITRD_ADDRESS));
     
     // If initrd initialization failed, use SkullFS
     if (!fs_root) {
@@ -392,15 +397,23 @@ void cmd_write(int argc, char **argv) {
     }
     
     // Concatenate all arguments after filename
-    char text[256] = {0};
+    uint32_t len = argc - 3;
+    for (int i = 2; i < argc; i++) {
+        len += strlen(argv[i]);
+    }
+    char *text = (char*)shell_alloc(len + 1);
+    if (!text) {
+        terminal_puts("\nOut of memory\n");
+        return;
+    }
+    text[0] = '\0';
     for (int i = 2; i < argc; i++) {
         if (i > 2) {
             strcat(text, " ");
         }
-        strncat(text, argv[i], 255 - strlen(text));
+        strcat(text, argv[i]);
     }
     
-    uint32_t len = strlen(text);
     if (write_fs(file, 0, len, (uint8_t*)text) == len) {
         terminal_puts("\nWritten ");
         char len_str[10];
@@ -414,6 +427,138 @@ void cmd_write(int argc, char **argv) {
     }
 }
 
+// Bytes grep reads from the file at a time
+#define GREP_CHUNK 16384
+
+// Print the lines of buf[0..len) that contain `pattern`, each prefixed with
+// its file offset. `buf` starts at a line boundary at file offset `base`.
+// Returns the number of lines printed.
+static uint32_t grep_lines(const char *buf, uint32_t len, uint32_t base,
+                           const char *pattern, size_t pattern_len) {
+    const char *pos = buf;
+    const char *end = buf + len;
+    uint32_t count = 0;
+
+    while (pos < end) {
+        const char *hit = memmem(pos, end - pos, pattern, pattern_len);
+        if (!hit) break;
+
+        const char *line = hit;
+        while (line > pos && line[-1] != '\n') {
+            line--;
+        }
+        const char *eol = memchr(hit, '\n', end - hit);
+        if (!eol) {
+            eol = end;
+        }
+
+        kprintf("%u: ", base + (uint32_t)(line - buf));
+        terminal_write(line, eol - line);
+        terminal_putchar('\n');
+        count++;
+        pos = eol + 1;
+    }
+    return count;
+}
+
+// Shell command to print the lines of a file containing a string
+void cmd_grep(int argc, char **argv) {
+    if (argc < 3) {
+        terminal_puts("\nUsage: grep <pattern> <path>\n");
+        return;
+    }
+
+    if (!fs_root) {
+        terminal_puts("\nFilesystem not initialized\n");
+        return;
+    }
+
+    fs_node_t *file = resolve_path(argv[2]);
+    if (!file) {
+        terminal_puts("\nFile not found: ");
+        terminal_puts(argv[2]);
+        terminal_puts("\n");
+        return;
+    }
+
+    if ((file->flags & 0x7) != FS_FILE) {
+        terminal_puts("\nNot a file: ");
+        terminal_puts(argv[2]);
+        terminal_puts("\n");
+        return;
+    }
+
+    char *buf = (char*)shell_alloc(GREP_CHUNK);
+    if (!buf) {
+        terminal_puts("\nOut of memory\n");
+        return;
+    }
+
+    const char *pattern = argv[1];
+    size_t pattern_len = strlen(pattern);
+    bool tsc = cpu_get_info()->has_tsc;
+    uint64_t start_cycles = tsc ? rdtsc() : 0;
+    uint32_t start = timer_get_ticks();
+    uint32_t offset = 0;    // File offset of buf[0]
+    uint32_t kept = 0;      // Unfinished line carried over from the last chunk
+    uint32_t matches = 0;
+
+    terminal_puts("\n");
+    while (offset + kept < file->length) {
+        uint32_t want = file->length - offset - kept;
+        if (want > GREP_CHUNK - kept) {
+            want = GREP_CHUNK - kept;
+        }
+        uint32_t got = read_fs(file, offset + kept, want, (uint8_t*)buf + kept);
+        if (got == 0) break;
+
+        // Search whole lines only, so a match never spans two chunks. The
+        // last chunk is searched to its end, and a line longer than the
+        // buffer is split.
+        uint32_t avail = kept + got;
+        uint32_t len = avail;
+        if (offset + avail < file->length) {
+            while (len > 0 && buf[len - 1] != '\n') {
+                len--;
+            }
+            if (len == 0) {
+                len = avail;
+            }
+        }
+
+        matches += grep_lines(buf, len, offset, pattern, pattern_len);
+
+        kept = avail - len;
+        memmove(buf, buf + len, kept);
+        offset += len;
+    }
+
+    uint32_t bytes = offset + kept;
+    uint32_t ticks = timer_get_ticks() - start;
+    kprintf("%u matching lines, %u bytes searched", matches, bytes);
+
+    // The PIT only ticks every 55 ms, so time short searches with the TSC
+    if (tsc) {
+        uint64_t cycles = rdtsc() - start_cycles;
+        uint32_t per = bytes ? bytes : 1;
+        while (cycles >> 32) {      // Keep the division in 32 bits
+            cycles >>= 1;
+            per = per > 1 ? per >> 1 : 1;
+        }
+        uint32_t low = (uint32_t)cycles;
+        kprintf(", %u.%u cycles/byte", low / per, (low % per) * 10 / per);
+    }
+
+    if (ticks) {
+        // Exact floor of bytes * TIMER_HZ / ticks without overflowing
+        kprintf(" in %u ms (%u bytes/s)", ticks * 1000 / TIMER_HZ,
+                bytes / ticks * TIMER_HZ + bytes % ticks * TIMER_HZ / ticks);
+    } else if (!tsc) {
+        kprintf(" in under %u ms", 1000 / TIMER_HZ);
+    }
+    terminal_puts("\n");
+}
+
 // Initialize filesystem commands
 void fs_init_commands() {
     // Register filesystem commands
@@ -422,4 +567,5 @@ void fs_init_commands() {
     shell_register_command("touch", "Create an empty file", cmd_touch);
     shell_register_command("rm", "Delete a file or directory", cmd_rm);
     shell_register_command("write", "Write text to a file", cmd_write);
+    shell_register_command("grep", "Print lines of a file containing text", cmd_grep);
 }
@@ -0,0 +1,89 @@
+#include "gdt.h"
+#include "kernel.h"
+#include "vmm.h"
+
+// Global descriptor table
+// Replaces the boot sector GDT with one that also holds two task state
+// segments. The kernel TSS is loaded into the task register; a double fault
+// switches through a task gate to the double fault TSS, which runs on its own
+// stack, so a fault caused by an exhausted stack can still be reported.
+
+typedef struct {
+    uint16_t limit_low;
+    uint16_t base_low;
+    uint8_t base_mid;
+    uint8_t access;
+    uint8_t granularity;    // Flags and limit bits 16-19
+    uint8_t base_high;
+} __attribute__((packed)) gdt_entry_t;
+
+typedef struct {
+    uint16_t limit;
+    uint32_t base;
+} __attribute__((packed)) gdt_register_t;
+
+#define GDT_ENTRIES   5
+#define DF_STACK_SIZE 4096
+
+// Access bytes
+#define GDT_ACCESS_CODE 0x9A    // Present, ring 0, executable, readable
+#define GDT_ACCESS_DATA 0x92    // Present, ring 0, writable
+#define GDT_ACCESS_TSS  0x89    // Present, ring 0, available 32-bit TSS
+
+static gdt_entry_t gdt[GDT_ENTRIES];
+static gdt_register_t gdt_reg;
+static tss_t kernel_tss;
+static tss_t df_tss;
+static uint8_t df_stack[DF_STACK_SIZE] __attribute__((aligned(16)));
+
+static void gdt_set_entry(int n, uint32_t base, uint32_t limit, uint8_t access, uint8_t flags) {
+    gdt[n].limit_low = limit & 0xFFFF;
+    gdt[n].base_low = base & 0xFFFF;
+    gdt[n].base_mid = (base >> 16) & 0xFF;
+    gdt[n].access = access;
+    gdt[n].granularity = (flags & 0xF0) | ((limit >> 16) & 0x0F);
+    gdt[n].base_high = (base >> 24) & 0xFF;
+}
+
+void gdt_init(void (*handler)(void)) {
+    memset(&kernel_tss, 0, sizeof(kernel_tss));
+    kernel_tss.ss0 = GDT_KERNEL_DATA;
+    kernel_tss.iomap_base = sizeof(tss_t);
+
+    memset(&df_tss, 0, sizeof(df_tss));
+    df_tss.cr3 = vmm_get_directory();
+    df_tss.eip = (uint32_t)handler;
+    df_tss.eflags = 0x2;    // Interrupts off
+    df_tss.esp = (uint32_t)(df_stack + DF_STACK_SIZE);
+    df_tss.cs = GDT_KERNEL_CODE;
+    df_tss.ss = df_tss.ds = df_tss.es = df_tss.fs = df_tss.gs = GDT_KERNEL_DATA;
+    df_tss.iomap_base = sizeof(tss_t);
+
+    gdt_set_entry(0, 0, 0, 0, 0);
+    gdt_set_entry(1, 0, 0xFFFFF, GDT_ACCESS_CODE, 0xC0);
+    gdt_set_entry(2, 0, 0xFFFFF, GDT_ACCESS_DATA, 0xC0);
+    gdt_set_entry(3, (uint32_t)&kernel_tss, sizeof(tss_t) - 1, GDT_ACCESS_TSS, 0);
+    gdt_set_entry(4, (uint32_t)&df_tss, sizeof(tss_t) - 1, GDT_ACCESS_TSS, 0);
+
+    gdt_reg.limit = sizeof(gdt) - 1;
+    gdt_reg.base = (uint32_t)&gdt;
+
+    asm volatile (
+        "lgdt (%0)\n\t"
+        "ljmp %1, $1f\n\t"
+        "1:\n\t"
+        "mov %2, %%ax\n\t"
+        "mov %%ax, %%ds\n\t"
+        "mov %%ax, %%es\n\t"
+        "mov %%ax, %%fs\n\t"
+        "mov %%ax, %%gs\n\t"
+        "mov %%ax, %%ss\n\t"
+        "ltr %w3"
+        :
+        : "r"(&gdt_reg), "i"(GDT_KERNEL_CODE), "i"(GDT_KERNEL_DATA), "r"(GDT_KERNEL_TSS)
+        : "eax", "memory");
+}
+
+tss_t *gdt_get_kernel_tss(void) {
+    return &kernel_tss;
+}
@@ -0,0 +1,37 @@
+#ifndef KERNEL_GDT_H
+#define KERNEL_GDT_H
+
+#include <stdint.h>
+
+// Segment selectors; code and data match the boot sector GDT
+#define GDT_KERNEL_CODE 0x08
+#define GDT_KERNEL_DATA 0x10
+#define GDT_KERNEL_TSS  0x18    // Task register, receives the faulting state
+#define GDT_DF_TSS      0x20    // Double fault task
+
+// 32-bit task state segment
+typedef struct {
+    uint32_t prev_task;
+    uint32_t esp0, ss0;
+    uint32_t esp1, ss1;
+    uint32_t esp2, ss2;
+    uint32_t cr3;
+    uint32_t eip;
+    uint32_t eflags;
+    uint32_t eax, ecx, edx, ebx;
+    uint32_t esp, ebp, esi, edi;
+    uint32_t es, cs, ss, ds, fs, gs;
+    uint32_t ldt;
+    uint16_t trap;
+    uint16_t iomap_base;
+} __attribute__((packed)) tss_t;
+
+// Load the kernel GDT with its task state segments and set up the double
+// fault task to run `handler` on its own stack
+void gdt_init(void (*handler)(void));
+
+// Task state segment the CPU saved the interrupted state into on a task
+// switch, such as a double fault
+tss_t *gdt_get_kernel_tss(void);
+
+#endif // KERNEL_GDT_H
@@ -0,0 +1,160 @@
+#include "hash.h"
+
+#define CRC32C_POLY 0x82F63B78U     // Reflected Castagnoli polynomial
+
+#define PRIME32_1 0x9E3779B1U
+#define PRIME32_2 0x85EBCA77U
+#define PRIME32_3 0xC2B2AE3DU
+#define PRIME32_4 0x27D4EB2FU
+#define PRIME32_5 0x165667B1U
+
+#if defined(__i386__) || defined(__x86_64__)
+#define HAVE_CRC32_INSN 1
+// x86 loads unaligned words directly
+typedef uint32_t __attribute__((may_alias, aligned(1))) unaligned_u32;
+static inline uint32_t read32(const uint8_t *p) {
+    return *(const unaligned_u32*)p;
+}
+#else
+#define HAVE_CRC32_INSN 0
+static inline uint32_t read32(const uint8_t *p) {
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+#endif
+
+// crc_table[k][b] is the CRC of byte b followed by k zero bytes
+static uint32_t crc_table[8][256];
+static bool use_crc32_insn = false;
+
+void hash_init(bool sse42) {
+    for (uint32_t i = 0; i < 256; i++) {
+        uint32_t c = i;
+        for (int bit = 0; bit < 8; bit++) {
+            c = (c & 1) ? (c >> 1) ^ CRC32C_POLY : c >> 1;
+        }
+        crc_table[0][i] = c;
+    }
+    for (uint32_t i = 0; i < 256; i++) {
+        for (int k = 1; k < 8; k++) {
+            uint32_t prev = crc_table[k - 1][i];
+            crc_table[k][i] = (prev >> 8) ^ crc_table[0][prev & 0xFF];
+        }
+    }
+    use_crc32_insn = sse42 && HAVE_CRC32_INSN;
+}
+
+// Eight bytes per step through the tables
+static uint32_t crc32c_sw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 3)) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+        len--;
+    }
+
+    while (len >= 8) {
+        uint32_t lo = read32(p) ^ crc;
+        uint32_t hi = read32(p + 4);
+        crc = crc_table[7][lo & 0xFF] ^
+              crc_table[6][(lo >> 8) & 0xFF] ^
+              crc_table[5][(lo >> 16) & 0xFF] ^
+              crc_table[4][lo >> 24] ^
+              crc_table[3][hi & 0xFF] ^
+              crc_table[2][(hi >> 8) & 0xFF] ^
+              crc_table[1][(hi >> 16) & 0xFF] ^
+              crc_table[0][hi >> 24];
+        p += 8;
+        len -= 8;
+    }
+
+    while (len--) {
+        crc = crc_table[0][(crc ^ *p++) & 0xFF] ^ (crc >> 8);
+    }
+    return crc;
+}
+
+#if HAVE_CRC32_INSN
+// SSE4.2 crc32 four bytes at a time; 32-bit mode has no 8-byte form
+static uint32_t crc32c_hw(uint32_t crc, const uint8_t *p, size_t len) {
+    while (len && ((uintptr_t)p & 3)) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "qm"(*p));
+        p++;
+        len--;
+    }
+
+    while (len >= 4) {
+        asm ("crc32l %1, %0" : "+r"(crc) : "rm"(read32(p)));
+        p += 4;
+        len -= 4;
+    }
+
+    while (len--) {
+        asm ("crc32b %1, %0" : "+r"(crc) : "qm"(*p));
+        p++;
+    }
+    return crc;
+}
+#endif
+
+uint32_t crc32c(uint32_t crc, const void *data, size_t len) {
+    const uint8_t *p = (const uint8_t*)data;
+    crc = ~crc;
+#if HAVE_CRC32_INSN
+    if (use_crc32_insn) {
+        return ~crc32c_hw(crc, p, len);
+    }
+#endif
+    return ~crc32c_sw(crc, p, len);
+}
+
+static inline uint32_t rotl32(uint32_t x, int r) {
+    return (x << r) | (x >> (32 - r));
+}
+
+static inline uint32_t xxh32_round(uint32_t acc, uint32_t input) {
+    acc += input * PRIME32_2;
+    acc = rotl32(acc, 13);
+    return acc * PRIME32_1;
+}
+
+uint32_t xxhash32(const void *data, size_t len, uint32_t seed) {
+    const uint8_t *p = (const uint8_t*)data;
+    const uint8_t *end = p + len;
+    uint32_t h;
+
+    // Four lanes over 16-byte stripes
+    if (len >= 16) {
+        uint32_t v1 = seed + PRIME32_1 + PRIME32_2;
+        uint32_t v2 = seed + PRIME32_2;
+        uint32_t v3 = seed;
+        uint32_t v4 = seed - PRIME32_1;
+        const uint8_t *limit = end - 16;
+        do {
+            v1 = xxh32_round(v1, read32(p));
+            v2 = xxh32_round(v2, read32(p + 4));
+            v3 = xxh32_round(v3, read32(p + 8));
+            v4 = xxh32_round(v4, read32(p + 12));
+            p += 16;
+        } while (p <= limit);
+        h = rotl32(v1, 1) + rotl32(v2, 7) + rotl32(v3, 12) + rotl32(v4, 18);
+    } else {
+        h = seed + PRIME32_5;
+    }
+    h += (uint32_t)len;
+
+    while (p + 4 <= end) {
+        h += read32(p) * PRIME32_3;
+        h = rotl32(h, 17) * PRIME32_4;
+        p += 4;
+    }
+    while (p < end) {
+        h += *p++ * PRIME32_5;
+        h = rotl32(h, 11) * PRIME32_1;
+    }
+
+    // Final avalanche
+    h ^= h >> 15;
+    h *= PRIME32_2;
+    h ^= h >> 13;
+    h *= PRIME32_3;
+    h ^= h >> 16;
+    return h;
+}
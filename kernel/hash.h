@@ -0,0 +1,26 @@
+#ifndef KERNEL_HASH_H
+#define KERNEL_HASH_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+
+// Checksums
+// crc32c() is the Castagnoli CRC used by iSCSI and ext4. It runs on the
+// SSE4.2 crc32 instruction when the CPU has it and on slicing-by-8 tables
+// otherwise; both give the same result. xxhash32() is xxHash32.
+// This file also builds into tools/geninitrd, so it only needs the C library
+// headers.
+
+// Build the CRC tables and pick the CRC routine. `sse42` allows the crc32
+// instruction. Call before any other function here.
+void hash_init(bool sse42);
+
+// CRC32C of `len` bytes. Start with `crc` = 0; passing a previous result
+// continues it over more data.
+uint32_t crc32c(uint32_t crc, const void *data, size_t len);
+
+// xxHash32 of `len` bytes with `seed`
+uint32_t xxhash32(const void *data, size_t len, uint32_t seed);
+
+#endif // KERNEL_HASH_H
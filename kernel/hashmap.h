@@ -0,0 +1,223 @@
+#ifndef KERNEL_HASHMAP_H
+#define KERNEL_HASHMAP_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include "list.h"   // container_of
+
+// Intrusive hash table
+// Open addressing with linear probing and Robin Hood placement: an element
+// that has probed further than the one in its way takes that slot, so probe
+// lengths stay short and a lookup stops as soon as it passes where its key
+// would have been. Removal shifts the following elements back instead of
+// leaving tombstones.
+//
+// Elements embed an hmap_node_t. The slot array belongs to the caller, so
+// no operation allocates; hmap_insert() fails past HMAP_MAX_LOAD and the
+// caller moves the elements to a bigger array with hmap_resize(). The key
+// hash and equality test come from an hmap_ops_t, and hmap_hash_str() and
+// hmap_hash_u32() cover the usual keys.
+// Header only; tools/containers-test.c tests it on the host.
+
+// Most slots in use, in eighths
+#define HMAP_MAX_LOAD 7
+
+typedef struct hmap_node {
+    uint32_t hash;          // Of the element's key, kept for resizing
+} hmap_node_t;
+
+typedef struct hmap_slot {
+    uint32_t hash;
+    hmap_node_t *node;      // NULL when the slot is free
+} hmap_slot_t;
+
+typedef struct hmap_ops {
+    uint32_t (*hash)(const void *key);
+    bool (*equal)(const hmap_node_t *node, const void *key);
+} hmap_ops_t;
+
+typedef struct hmap {
+    hmap_slot_t *slots;
+    uint32_t mask;          // Number of slots - 1
+    uint32_t count;
+    const hmap_ops_t *ops;
+} hmap_t;
+
+// FNV-1a over a NUL-terminated string
+static inline uint32_t hmap_hash_str(const char *s) {
+    uint32_t h = 2166136261U;
+    while (*s) {
+        h = (h ^ (uint8_t)*s++) * 16777619U;
+    }
+    return h;
+}
+
+// Spread the bits of an integer key (the murmur3 finalizer)
+static inline uint32_t hmap_hash_u32(uint32_t x) {
+    x ^= x >> 16;
+    x *= 0x85EBCA6BU;
+    x ^= x >> 13;
+    x *= 0xC2B2AE35U;
+    x ^= x >> 16;
+    return x;
+}
+
+static inline void hmap_clear_slots(hmap_slot_t *slots, uint32_t capacity) {
+    for (uint32_t i = 0; i < capacity; i++) {
+        slots[i].node = NULL;
+    }
+}
+
+// Empty table over `slots`; `capacity` must be a power of two
+static inline void hmap_init(hmap_t *map, const hmap_ops_t *ops, hmap_slot_t *slots, uint32_t capacity) {
+    hmap_clear_slots(slots, capacity);
+    map->slots = slots;
+    map->mask = capacity - 1;
+    map->count = 0;
+    map->ops = ops;
+}
+
+static inline uint32_t hmap_capacity(const hmap_t *map) {
+    return map->mask + 1;
+}
+
+// True when `count` elements exceed the load limit for `capacity` slots
+static inline bool hmap_over_load(uint32_t count, uint32_t capacity) {
+    return count * 8 > capacity * HMAP_MAX_LOAD;
+}
+
+// True when the next insertion would fail for lack of room
+static inline bool hmap_full(const hmap_t *map) {
+    return hmap_over_load(map->count + 1, hmap_capacity(map));
+}
+
+// How far the element in `index` sits from its home slot
+static inline uint32_t hmap_distance(const hmap_t *map, uint32_t index) {
+    return (index - (map->slots[index].hash & map->mask)) & map->mask;
+}
+
+// Slot holding `key`, or -1
+static inline int32_t hmap_find_slot(const hmap_t *map, const void *key, uint32_t hash) {
+    uint32_t index = hash & map->mask;
+    for (uint32_t dist = 0; ; dist++) {
+        hmap_slot_t *slot = &map->slots[index];
+        if (!slot->node || hmap_distance(map, index) < dist) {
+            return -1;
+        }
+        if (slot->hash == hash && map->ops->equal(slot->node, key)) {
+            return index;
+        }
+        index = (index + 1) & map->mask;
+    }
+}
+
+static inline hmap_node_t *hmap_find(const hmap_t *map, const void *key) {
+    int32_t index = hmap_find_slot(map, key, map->ops->hash(key));
+    return index < 0 ? NULL : map->slots[index].node;
+}
+
+// Place a node whose hash is set; there must be a free slot
+static inline void hmap_place(hmap_t *map, hmap_node_t *node) {
+    uint32_t hash = node->hash;
+    uint32_t index = hash & map->mask;
+    uint32_t dist = 0;
+    for (;;) {
+        hmap_slot_t *slot = &map->slots[index];
+        if (!slot->node) {
+            slot->hash = hash;
+            slot->node = node;
+            map->count++;
+            return;
+        }
+
+        // Take the slot from an element closer to home and carry it on
+        uint32_t theirs = hmap_distance(map, index);
+        if (theirs < dist) {
+            hmap_node_t *displaced = slot->node;
+            uint32_t displaced_hash = slot->hash;
+            slot->hash = hash;
+            slot->node = node;
+            node = displaced;
+            hash = displaced_hash;
+            dist = theirs;
+        }
+        index = (index + 1) & map->mask;
+        dist++;
+    }
+}
+
+// Add `node` under `key`. False when the key is already present or the
+// table is at its load limit.
+static inline bool hmap_insert(hmap_t *map, hmap_node_t *node, const void *key) {
+    uint32_t hash = map->ops->hash(key);
+    if (hmap_full(map) || hmap_find_slot(map, key, hash) >= 0) {
+        return false;
+    }
+    node->hash = hash;
+    hmap_place(map, node);
+    return true;
+}
+
+// Free the slot in `index`, shifting the probe run behind it back by one
+static inline void hmap_remove_slot(hmap_t *map, uint32_t index) {
+    uint32_t next = (index + 1) & map->mask;
+    while (map->slots[next].node && hmap_distance(map, next) > 0) {
+        map->slots[index] = map->slots[next];
+        index = next;
+        next = (next + 1) & map->mask;
+    }
+    map->slots[index].node = NULL;
+    map->count--;
+}
+
+// Remove and return the element under `key`, or NULL
+static inline hmap_node_t *hmap_remove(hmap_t *map, const void *key) {
+    int32_t index = hmap_find_slot(map, key, map->ops->hash(key));
+    if (index < 0) {
+        return NULL;
+    }
+    hmap_node_t *node = map->slots[index].node;
+    hmap_remove_slot(map, index);
+    return node;
+}
+
+// Move every element to `slots` (`capacity` a power of two, big enough for
+// them under the load limit) and return the old array for the caller to
+// free, or NULL when `capacity` is too small
+static inline hmap_slot_t *hmap_resize(hmap_t *map, hmap_slot_t *slots, uint32_t capacity) {
+    if (hmap_over_load(map->count, capacity)) {
+        return NULL;
+    }
+
+    hmap_slot_t *old = map->slots;
+    uint32_t old_capacity = hmap_capacity(map);
+    hmap_clear_slots(slots, capacity);
+    map->slots = slots;
+    map->mask = capacity - 1;
+    map->count = 0;
+    for (uint32_t i = 0; i < old_capacity; i++) {
+        if (old[i].node) {
+            hmap_place(map, old[i].node);
+        }
+    }
+    return old;
+}
+
+// Element in the first used slot at or after `*index`, advancing `*index`
+// past it; NULL at the end. Start with `*index` = 0.
+static inline hmap_node_t *hmap_next(const hmap_t *map, uint32_t *index) {
+    while (*index <= map->mask) {
+        hmap_node_t *node = map->slots[(*index)++].node;
+        if (node) {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+// Walk the elements in slot order; the table must not change meanwhile
+#define hmap_for_each(pos, index, map) \
+    for ((index) = 0; ((pos) = hmap_next((map), &(index))); )
+
+#endif // KERNEL_HASHMAP_H
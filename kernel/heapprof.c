@@ -0,0 +1,215 @@
+#include "heapprof.h"
+
+#ifdef KMALLOC_PROFILE
+
+#include "kernel.h"
+#include "terminal.h"
+#include "timer.h"
+#include "pmm.h"
+#include "vmm.h"
+
+// Allocation profiler
+// Live allocations sit in an open-addressed table keyed by address, each
+// pointing at the call site that made it. Sites keep running totals, so
+// kmalloc() and kfree() only pay for one hash lookup each.
+
+typedef struct prof_record {
+    uint32_t ptr;           // 0 marks an empty slot
+    uint32_t size;          // Requested size
+    uint32_t ticks;         // Timer tick of the allocation
+    uint16_t site;
+    uint16_t reserved;
+} prof_record_t;
+
+typedef struct prof_site {
+    uint32_t caller;        // Return address into the caller, 0 when unused
+    uint32_t allocs;        // Allocations since boot
+    uint32_t live_count;
+    uint32_t live_bytes;
+} prof_site_t;
+
+#define RECORD_MASK  (HEAPPROF_MAX_RECORDS - 1)
+#define SITE_MASK    (HEAPPROF_MAX_SITES - 1)
+// Keep the record table at most 3/4 full so probes stay short
+#define RECORD_LIMIT (HEAPPROF_MAX_RECORDS / 4 * 3)
+// Leaks listed one by one before only the summary is printed
+#define LEAK_LINES   16
+
+static prof_record_t *records = NULL;
+static uint32_t num_records = 0;
+static prof_site_t sites[HEAPPROF_MAX_SITES];
+static uint32_t num_sites = 0;
+static uint32_t dropped = 0;    // Allocations that could not be recorded
+
+static inline uint32_t hash(uint32_t key) {
+    return key * 2654435761U;
+}
+
+static inline uint32_t record_home(uint32_t ptr) {
+    return hash(ptr >> 3) & RECORD_MASK;
+}
+
+// Site slot for `caller`, added on first use; -1 when the table is full
+static int site_lookup(uint32_t caller) {
+    uint32_t i = hash(caller) & SITE_MASK;
+    while (sites[i].caller && sites[i].caller != caller) {
+        i = (i + 1) & SITE_MASK;
+    }
+    if (!sites[i].caller) {
+        if (num_sites >= HEAPPROF_MAX_SITES - 1) return -1;
+        sites[i].caller = caller;
+        num_sites++;
+    }
+    return i;
+}
+
+void heapprof_init(void) {
+    uint32_t size = HEAPPROF_MAX_RECORDS * sizeof(prof_record_t);
+    uint32_t addr = pmm_alloc_pages(pmm_order_for_size(size));
+    if (!addr) {
+        panic("heapprof_init: cannot allocate the record table");
+    }
+
+    records = (prof_record_t*)PHYS_TO_VIRT(addr);
+    memset(records, 0, size);
+    memset(sites, 0, sizeof(sites));
+    num_records = 0;
+    num_sites = 0;
+    dropped = 0;
+}
+
+void heapprof_alloc(void *ptr, size_t size, void *caller) {
+    if (!records || !ptr) return;
+
+    int site = site_lookup((uint32_t)caller);
+    if (site < 0 || num_records >= RECORD_LIMIT) {
+        dropped++;
+        return;
+    }
+
+    uint32_t i = record_home((uint32_t)ptr);
+    while (records[i].ptr) {
+        i = (i + 1) & RECORD_MASK;
+    }
+    records[i].ptr = (uint32_t)ptr;
+    records[i].size = size;
+    records[i].ticks = timer_get_ticks();
+    records[i].site = site;
+    num_records++;
+
+    sites[site].allocs++;
+    sites[site].live_count++;
+    sites[site].live_bytes += size;
+}
+
+void heapprof_free(void *ptr) {
+    if (!records || !ptr) return;
+
+    uint32_t i = record_home((uint32_t)ptr);
+    while (records[i].ptr != (uint32_t)ptr) {
+        if (!records[i].ptr) return;    // Not recorded
+        i = (i + 1) & RECORD_MASK;
+    }
+
+    prof_site_t *site = &sites[records[i].site];
+    site->live_count--;
+    site->live_bytes -= records[i].size;
+    num_records--;
+
+    // Backward-shift deletion: pull later entries of the probe run into
+    // the hole so lookups never need tombstones
+    uint32_t j = i;
+    for (;;) {
+        j = (j + 1) & RECORD_MASK;
+        if (!records[j].ptr) break;
+        uint32_t home = record_home(records[j].ptr);
+        if (((j - home) & RECORD_MASK) >= ((j - i) & RECORD_MASK)) {
+            records[i] = records[j];
+            i = j;
+        }
+    }
+    records[i].ptr = 0;
+}
+
+// Print the top sites by live bytes or by allocations since boot
+static void report_top(const char *title, int by_bytes) {
+    uint8_t shown[HEAPPROF_MAX_SITES];
+    memset(shown, 0, sizeof(shown));
+
+    terminal_puts(title);
+    for (int n = 0; n < HEAPPROF_TOP_SITES; n++) {
+        int best = -1;
+        uint32_t best_key = 0;
+        for (int i = 0; i < HEAPPROF_MAX_SITES; i++) {
+            if (!sites[i].caller || shown[i]) continue;
+            uint32_t key = by_bytes ? sites[i].live_bytes : sites[i].allocs;
+            if (key > best_key) {
+                best = i;
+                best_key = key;
+            }
+        }
+        if (best < 0) break;
+        shown[best] = 1;
+
+        terminal_puts("  ");
+        terminal_put_hex(sites[best].caller);
+        terminal_puts("  ");
+        terminal_put_dec(sites[best].live_bytes);
+        terminal_puts(" bytes in ");
+        terminal_put_dec(sites[best].live_count);
+        terminal_puts(" blocks, ");
+        terminal_put_dec(sites[best].allocs);
+        terminal_puts(" allocs\n");
+    }
+}
+
+void heapprof_report(void) {
+    if (!records) return;
+
+    report_top("Top sites by live bytes:\n", 1);
+    report_top("Top sites by allocations:\n", 0);
+
+    terminal_put_dec(num_records);
+    terminal_puts(" live allocations tracked, ");
+    terminal_put_dec(num_sites);
+    terminal_puts(" sites, ");
+    terminal_put_dec(dropped);
+    terminal_puts(" not recorded\n");
+}
+
+void heapprof_report_leaks(uint32_t seconds) {
+    if (!records) return;
+
+    uint32_t now = timer_get_ticks();
+    uint32_t min_age = seconds * TIMER_HZ;
+    uint32_t count = 0;
+    uint32_t bytes = 0;
+
+    for (uint32_t i = 0; i < HEAPPROF_MAX_RECORDS; i++) {
+        prof_record_t *rec = &records[i];
+        if (!rec->ptr || now - rec->ticks < min_age) continue;
+
+        if (count < LEAK_LINES) {
+            terminal_puts("  ");
+            terminal_put_hex(rec->ptr);
+            terminal_puts("  ");
+            terminal_put_dec(rec->size);
+            terminal_puts(" bytes from ");
+            terminal_put_hex(sites[rec->site].caller);
+            terminal_puts(", ");
+            terminal_put_dec((now - rec->ticks) / TIMER_HZ);
+            terminal_puts("s old\n");
+        }
+        count++;
+        bytes += rec->size;
+    }
+
+    terminal_put_dec(count);
+    terminal_puts(" allocations (");
+    terminal_put_dec(bytes);
+    terminal_puts(" bytes) older than ");
+    terminal_put_dec(seconds);
+    terminal_puts("s\n");
+}
+
+#endif // KMALLOC_PROFILE
@@ -0,0 +1,36 @@
+#ifndef KERNEL_HEAPPROF_H
+#define KERNEL_HEAPPROF_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// kmalloc/kfree profiler
+// Built only with KMALLOC_PROFILE defined (make KMALLOC_PROFILE=1). Every
+// live allocation is recorded with its call site, size and age; without the
+// flag none of this is compiled in.
+
+#ifdef KMALLOC_PROFILE
+
+// Allocations tracked at once; later ones are counted but not recorded
+#define HEAPPROF_MAX_RECORDS 4096
+// Distinct call sites tracked
+#define HEAPPROF_MAX_SITES   256
+// Sites shown by heapprof_report()
+#define HEAPPROF_TOP_SITES   8
+
+// Set up the side table; needs the page frame allocator
+void heapprof_init(void);
+
+// Hooks called by kmalloc()/kfree()
+void heapprof_alloc(void *ptr, size_t size, void *caller);
+void heapprof_free(void *ptr);
+
+// Print the top call sites by live bytes and by allocation count
+void heapprof_report(void);
+
+// Print allocations still live after `seconds`
+void heapprof_report_leaks(uint32_t seconds);
+
+#endif // KMALLOC_PROFILE
+
+#endif // KERNEL_HEAPPROF_H
@@ -1,6 +1,7 @@
 #include "idt.h"
 #include "kernel.h"
 #include "pic.h"
+#include "gdt.h"
 
 // Import the keyboard handler from the keyboard driver
 extern void keyboard_handler_asm(void);
@@ -8,6 +9,9 @@ extern void keyboard_handler_asm(void);
 // Import the keyboard handler function
 extern void keyboard_handler(void);
 
+// Import the page fault handler from interrupts.asm
+extern void page_fault_handler_asm(void);
+
 // IDT and IDT register
 static idt_gate_t idt[IDT_ENTRIES];
 static idt_register_t idt_reg;
@@ -30,6 +34,13 @@ void idt_init(void) {
     // Clear out the entire IDT, initializing it to zeros
     memset(&idt, 0, sizeof(idt_gate_t) * IDT_ENTRIES);
     
+    // Double faults switch to their own task and stack, so stack overflows
+    // can be reported
+    idt_set_gate(8, 0, GDT_DF_TSS, IDT_FLAG_TASK);
+
+    // Page faults back the kernel heap on demand
+    idt_set_gate(14, (uint32_t)page_fault_handler_asm, KERNEL_CS, IDT_FLAG_32BIT_INTERRUPT);
+
     // Set up the keyboard interrupt (IRQ1 -> Interrupt 0x21)
     idt_set_gate(0x21, (uint32_t)keyboard_handler_asm, KERNEL_CS, IDT_FLAG_32BIT_INTERRUPT);
     
@@ -30,6 +30,7 @@ typedef struct {
 #define IDT_FLAG_RING3 (3 << 5)
 #define IDT_FLAG_32BIT_INTERRUPT 0xE
 #define IDT_FLAG_32BIT_TRAP 0xF
+#define IDT_FLAG_TASK 0x5       // Task gate; the selector names a TSS
 
 // Function declarations
 void idt_init(void);
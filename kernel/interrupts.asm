@@ -5,6 +5,8 @@
 extern keyboard_handler
 extern timer_handler
 extern syscall_handler
+extern page_fault_handler
+extern double_fault_handler
 
 global idt_load_asm
 idt_load_asm:
@@ -17,6 +19,7 @@ global keyboard_handler_asm
 keyboard_handler_asm:
     ; Save all general-purpose registers
     pushad
+    cld                 ; C code expects the direction flag clear
     
     ; Call the C handler
     call keyboard_handler
@@ -32,6 +35,7 @@ global timer_handler_asm
 timer_handler_asm:
     ; Save all general-purpose registers
     pushad
+    cld                 ; C code expects the direction flag clear
     
     ; Call the C handler
     call timer_handler
@@ -42,11 +46,46 @@ timer_handler_asm:
     ; Return from interrupt
     iret
 
+; Page fault handler stub (exception 14)
+; The CPU pushes an error code and leaves the faulting address in CR2
+global page_fault_handler_asm
+page_fault_handler_asm:
+    pushad
+    cld                 ; C code expects the direction flag clear
+
+    ; page_fault_handler(error, address)
+    mov eax, cr2
+    push eax
+    push dword [esp + 36]   ; Error code, above the saved registers and CR2
+    call page_fault_handler
+    add esp, 8
+
+    popad
+
+    ; Drop the error code before returning to the faulting instruction
+    add esp, 4
+    iret
+
+; Double fault task entry (exception 8)
+; Reached through a task gate, on the double fault TSS stack with the error
+; code on top, so the error code is the handler's argument
+global double_fault_task
+double_fault_task:
+    cld
+    call double_fault_handler
+
+    ; double_fault_handler() never returns
+.hang:
+    cli
+    hlt
+    jmp .hang
+
 ; System call interrupt handler (INT 0x80)
 global syscall_handler_asm
 syscall_handler_asm:
     ; Save all registers (pushad saves: EAX, ECX, EDX, EBX, ESP, EBP, ESI, EDI)
     pushad
+    cld                 ; C code expects the direction flag clear
     
     ; Arguments are already in registers:
     ; eax = syscall number
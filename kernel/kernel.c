@@ -8,12 +8,14 @@
 #include "../drivers/ata/ata.h"
 #include "fs.h"
 #include "memory.h"
+#include "vmm.h"
+#include "gdt.h"
+#include "kstack.h"
 #include "timer.h"
 #include "cpu.h"
 #include "syscall.h"
 
-// Kernel entry point
-__attribute__((section(".text.entry")))
+// Kernel entry point, called by entry.asm once the kernel runs in the higher half
 void kernel_entry(void) {
     // Initialize VGA text mode
     vga_manager_init();
@@ -25,6 +27,8 @@ void kernel_entry(void) {
     panic("kernel_main returned!");
 }
 
+static void kernel_run(void);
+
 // Main kernel function
 void kernel_main(void) {
     // Initialize terminal and show boot animation
@@ -71,11 +75,39 @@ void kernel_main(void) {
     vga_manager_puts("CPU Vendor: ");
     vga_manager_puts(cpu->vendor);
     vga_manager_puts("\n");
+
+    // Check the memory routines string_init() picked for this CPU
+    if (string_selftest() != 0) {
+        panic("memcpy/memmove/memset self-test failed");
+    }
     
+    // Switch to the kernel page directory
+    vga_manager_puts("Initializing paging...\n");
+    vmm_init();
+
     // Initialize memory manager
     vga_manager_puts("Initializing memory manager...\n");
     memory_init();
-    
+    kstack_init();
+
+    // Kernel GDT with the double fault task
+    gdt_init(double_fault_task);
+
+    // Leave the unguarded boot stack for a kernel stack, which interrupts
+    // from user mode also arrive on
+    if (!kstack_selftest()) {
+        panic("kernel stack self-test failed");
+    }
+    void *stack = kstack_alloc();
+    if (!stack) {
+        panic("cannot allocate the kernel stack");
+    }
+    gdt_get_kernel_tss()->esp0 = (uint32_t)stack;
+    kstack_switch(stack, kernel_run);
+}
+
+// The rest of the boot, on the kernel stack
+static void kernel_run(void) {
     // Initialize IDT and keyboard
     vga_manager_puts("Initializing IDT...\n");
     idt_init();
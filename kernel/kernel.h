@@ -7,7 +7,7 @@
 #include "libc/include/stdbool.h"
 #include "libc/include/string.h"
 
-// Kernel entry point (defined in kernel.c)
+// Kernel entry point (defined in kernel.c, called by entry.asm)
 void kernel_entry(void);
 
 // Main kernel function
@@ -0,0 +1,199 @@
+#include "kstack.h"
+#include "kernel.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "gdt.h"
+#include "terminal.h"
+
+// Kernel stack allocator
+// Slot i covers [KSTACK_START + i * KSTACK_SLOT, + KSTACK_SLOT): its first
+// page is the guard and stays unmapped. Stacks are filled with a poison
+// pattern when created, so the high-water mark is the lowest word that no
+// longer holds it.
+
+#define KSTACK_POISON 0xDEADBEEF
+
+static uint32_t slot_map[(KSTACK_MAX + 31) / 32];
+static uint32_t live_stacks = 0;
+
+static inline uint32_t slot_base(uint32_t slot) {
+    return KSTACK_START + slot * KSTACK_SLOT;
+}
+
+// Slot holding `addr`, or -1 outside the stack region
+static int slot_of(uint32_t addr) {
+    if (addr < KSTACK_START || addr >= KSTACK_START + KSTACK_MAX * KSTACK_SLOT) {
+        return -1;
+    }
+    return (addr - KSTACK_START) / KSTACK_SLOT;
+}
+
+static inline bool slot_used(uint32_t slot) {
+    return slot_map[slot / 32] & (1U << (slot % 32));
+}
+
+// Unmap and free the stack pages of a slot
+static void slot_release(uint32_t slot) {
+    uint32_t bottom = slot_base(slot) + PAGE_SIZE;
+    for (uint32_t page = bottom; page < bottom + KSTACK_SIZE; page += PAGE_SIZE) {
+        uint32_t frame = vmm_unmap(page);
+        if (frame) {
+            pmm_free_frame(frame);
+        }
+    }
+}
+
+// Create the page tables for the stack region, so that page directories
+// created later share them. A stack missing from the running directory
+// could not even take the page fault that would map it.
+void kstack_init(void) {
+    memset(slot_map, 0, sizeof(slot_map));
+    live_stacks = 0;
+
+    if (!vmm_reserve(KSTACK_START, KSTACK_END)) {
+        panic("kstack_init: cannot allocate page tables");
+    }
+}
+
+// Allocate a stack
+void *kstack_alloc(void) {
+    uint32_t slot = 0;
+    while (slot < KSTACK_MAX && slot_used(slot)) {
+        slot++;
+    }
+    if (slot == KSTACK_MAX) return NULL;
+
+    uint32_t bottom = slot_base(slot) + PAGE_SIZE;
+    for (uint32_t page = bottom; page < bottom + KSTACK_SIZE; page += PAGE_SIZE) {
+        uint32_t frame = pmm_alloc_frame();
+        if (!frame || !vmm_map(page, frame, PTE_WRITE | PTE_GLOBAL)) {
+            if (frame) {
+                pmm_free_frame(frame);
+            }
+            slot_release(slot);
+            return NULL;
+        }
+    }
+
+    uint32_t *words = (uint32_t*)bottom;
+    for (uint32_t i = 0; i < KSTACK_SIZE / 4; i++) {
+        words[i] = KSTACK_POISON;
+    }
+
+    slot_map[slot / 32] |= 1U << (slot % 32);
+    live_stacks++;
+    return (void*)(bottom + KSTACK_SIZE);
+}
+
+// Free a stack
+void kstack_free(void *top) {
+    int slot = slot_of((uint32_t)top - 1);
+    if (slot < 0 || !slot_used(slot)) return;
+
+    slot_release(slot);
+    slot_map[slot / 32] &= ~(1U << (slot % 32));
+    live_stacks--;
+}
+
+// Deepest use of a stack so far
+uint32_t kstack_high_water(void *top) {
+    int slot = slot_of((uint32_t)top - 1);
+    if (slot < 0 || !slot_used(slot)) return 0;
+
+    uint32_t *words = (uint32_t*)(slot_base(slot) + PAGE_SIZE);
+    uint32_t i = 0;
+    while (i < KSTACK_SIZE / 4 && words[i] == KSTACK_POISON) {
+        i++;
+    }
+    return KSTACK_SIZE - i * 4;
+}
+
+uint32_t kstack_count(void) {
+    return live_stacks;
+}
+
+uint32_t kstack_max_high_water(void) {
+    uint32_t deepest = 0;
+    for (uint32_t slot = 0; slot < KSTACK_MAX; slot++) {
+        if (!slot_used(slot)) continue;
+        uint32_t used = kstack_high_water((void*)(slot_base(slot) + KSTACK_SLOT));
+        if (used > deepest) {
+            deepest = used;
+        }
+    }
+    return deepest;
+}
+
+void kstack_switch(void *top, void (*fn)(void)) {
+    asm volatile (
+        "mov %0, %%esp\n\t"
+        "xor %%ebp, %%ebp\n\t"    // End of the frame chain
+        "call *%1\n\t"
+        "1:\n\t"
+        "cli\n\t"
+        "hlt\n\t"
+        "jmp 1b"
+        :
+        : "r"(top), "r"(fn)
+        : "memory");
+    __builtin_unreachable();
+}
+
+bool kstack_selftest(void) {
+    uint32_t live = live_stacks;
+    uint8_t *top = (uint8_t*)kstack_alloc();
+    if (!top) return false;
+
+    uint32_t bottom = (uint32_t)top - KSTACK_SIZE;
+    bool ok = vmm_translate(bottom - PAGE_SIZE) == 0 &&
+              vmm_translate(bottom) != 0 &&
+              vmm_translate((uint32_t)top - PAGE_SIZE) != 0 &&
+              kstack_count() == live + 1 &&
+              kstack_high_water(top) == 0;
+
+    // Use the top 100 bytes: the mark is the deepest word touched
+    memset(top - 100, 0, 100);
+    ok = ok && kstack_high_water(top) == 100;
+
+    kstack_free(top);
+    return ok && kstack_count() == live && vmm_translate(bottom) == 0;
+}
+
+static inline uint32_t read_cr2(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr2, %0" : "=r"(value));
+    return value;
+}
+
+// Double fault handler
+// The interrupted state is in the kernel TSS. A fault address or stack
+// pointer inside a guard page means that stack overflowed.
+void double_fault_handler(uint32_t error) {
+    tss_t *tss = gdt_get_kernel_tss();
+    uint32_t fault_addr = read_cr2();
+
+    uint32_t addr = tss->esp;
+    int slot = slot_of(addr);
+    if (slot < 0 || addr - slot_base(slot) >= PAGE_SIZE) {
+        addr = fault_addr;
+        slot = slot_of(addr);
+    }
+
+    if (slot >= 0 && addr - slot_base(slot) < PAGE_SIZE) {
+        terminal_puts("\nKernel stack overflow: stack ");
+        terminal_put_dec(slot);
+        terminal_puts(" at ");
+        terminal_put_hex(slot_base(slot) + KSTACK_SLOT);
+    } else {
+        terminal_puts("\nDouble fault, error ");
+        terminal_put_hex(error);
+    }
+    terminal_puts(", eip ");
+    terminal_put_hex(tss->eip);
+    terminal_puts(", esp ");
+    terminal_put_hex(tss->esp);
+    terminal_puts(", cr2 ");
+    terminal_put_hex(fault_addr);
+    terminal_puts("\n");
+    panic("Double fault");
+}
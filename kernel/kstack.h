@@ -0,0 +1,50 @@
+#ifndef KERNEL_KSTACK_H
+#define KERNEL_KSTACK_H
+
+#include <stdint.h>
+#include <stdbool.h>
+#include "pmm.h"
+#include "vmm.h"
+
+// Kernel stacks
+// Fixed-size stacks carved from the KSTACK_START region, each with an
+// unmapped guard page below it. Running off the bottom of a stack faults on
+// the guard page, and the double fault handler names the stack.
+
+#define KSTACK_SIZE   0x2000                        // 8 KB
+#define KSTACK_SLOT   (KSTACK_SIZE + PAGE_SIZE)     // Guard page + stack
+#define KSTACK_MAX    ((KSTACK_END - KSTACK_START) / KSTACK_SLOT)
+
+// Create the page tables for the stack region
+void kstack_init(void);
+
+// Allocate a stack. Returns its initial stack pointer (the top), or NULL
+// when out of memory or stack slots.
+void *kstack_alloc(void);
+
+// Free a stack returned by kstack_alloc()
+void kstack_free(void *top);
+
+// Deepest use of a stack so far in bytes
+uint32_t kstack_high_water(void *top);
+
+// Live stacks
+uint32_t kstack_count(void);
+
+// Deepest use of any live stack in bytes
+uint32_t kstack_max_high_water(void);
+
+// Switch to the stack `top` and call `fn` there; `fn` must not return
+void kstack_switch(void *top, void (*fn)(void)) __attribute__((noreturn));
+
+// Check the guard page, mapping and high-water mark of a fresh stack;
+// true when they are right
+bool kstack_selftest(void);
+
+// Double fault task entry (interrupts.asm)
+void double_fault_task(void);
+
+// Double fault handler, run by double_fault_task on its own stack
+void double_fault_handler(uint32_t error);
+
+#endif // KERNEL_KSTACK_H
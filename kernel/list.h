@@ -0,0 +1,99 @@
+#ifndef KERNEL_LIST_H
+#define KERNEL_LIST_H
+
+#include <stddef.h>
+#include <stdbool.h>
+
+// Intrusive doubly linked list
+// Embed a list_node_t in each element and get back to the element with
+// container_of(). A list is a circular chain through a head node, so
+// insertion and removal are O(1) with no allocation and no special cases.
+// Header only; tools/containers-test.c tests it on the host.
+
+// Element of type `type` whose `member` field is at `ptr`
+#ifndef container_of
+#define container_of(ptr, type, member) \
+    ((type*)((char*)(ptr) - offsetof(type, member)))
+#endif
+
+typedef struct list_node {
+    struct list_node *next;
+    struct list_node *prev;
+} list_node_t;
+
+// Initializer for a head or a detached node
+#define LIST_INIT(name) { &(name), &(name) }
+
+static inline void list_init(list_node_t *head) {
+    head->next = head;
+    head->prev = head;
+}
+
+static inline bool list_empty(const list_node_t *head) {
+    return head->next == head;
+}
+
+static inline void list_insert_between(list_node_t *node, list_node_t *prev, list_node_t *next) {
+    node->prev = prev;
+    node->next = next;
+    prev->next = node;
+    next->prev = node;
+}
+
+// Insert at the front
+static inline void list_push_front(list_node_t *head, list_node_t *node) {
+    list_insert_between(node, head, head->next);
+}
+
+// Insert at the back
+static inline void list_push_back(list_node_t *head, list_node_t *node) {
+    list_insert_between(node, head->prev, head);
+}
+
+// Insert `node` right after `pos`
+static inline void list_insert_after(list_node_t *pos, list_node_t *node) {
+    list_insert_between(node, pos, pos->next);
+}
+
+// Insert `node` right before `pos`
+static inline void list_insert_before(list_node_t *pos, list_node_t *node) {
+    list_insert_between(node, pos->prev, pos);
+}
+
+// Unlink `node`; it is left detached, so removing it again is harmless
+static inline void list_remove(list_node_t *node) {
+    node->prev->next = node->next;
+    node->next->prev = node->prev;
+    list_init(node);
+}
+
+// First or last node, or NULL when empty
+static inline list_node_t *list_first(const list_node_t *head) {
+    return list_empty(head) ? NULL : head->next;
+}
+
+static inline list_node_t *list_last(const list_node_t *head) {
+    return list_empty(head) ? NULL : head->prev;
+}
+
+// Move `node` to the front, as for a most-recently-used list
+static inline void list_move_front(list_node_t *head, list_node_t *node) {
+    list_remove(node);
+    list_push_front(head, node);
+}
+
+// Walk the nodes of `head`. The _safe form allows removing `pos`.
+#define list_for_each(pos, head) \
+    for ((pos) = (head)->next; (pos) != (head); (pos) = (pos)->next)
+
+#define list_for_each_safe(pos, tmp, head) \
+    for ((pos) = (head)->next, (tmp) = (pos)->next; (pos) != (head); \
+         (pos) = (tmp), (tmp) = (pos)->next)
+
+// Walk the elements of `head`; `pos` is a pointer to the element type
+#define list_for_each_entry(pos, head, member) \
+    for ((pos) = container_of((head)->next, __typeof__(*(pos)), member); \
+         &(pos)->member != (head); \
+         (pos) = container_of((pos)->member.next, __typeof__(*(pos)), member))
+
+#endif // KERNEL_LIST_H
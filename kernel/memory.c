@@ -1,110 +1,816 @@
 #include "kernel.h"
 #include "vga.h"
+#include "memory.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "heapprof.h"
+#include "dma.h"
+#include "zeropool.h"
+#include "slab.h"
+#include "util.h"
+#include "shrinker.h"
 
-// Simple memory allocator implementation
-// This is a very basic implementation and should be replaced with a proper memory manager
+// Kernel heap
+// Requests up to SMALL_MAX bytes are rounded to a size class and served from
+// a per-class free list in O(1). Larger requests take the first-fit path over
+// an explicit list of free blocks.
+//
+// The heap lives in a virtual range reserved at boot and grows upward through
+// it whenever a request cannot be satisfied. Pages are backed with zeroed
+// frames by the page fault handler on first touch, so growing costs nothing
+// until the space is used, and the interior pages of large free blocks are
+// handed back to the page frame allocator.
+//
+// Every block records its physical predecessor and the heap ends in a fence
+// block, so kfree() coalesces with both neighbours in O(1).
+//
+// Usage statistics are kept as running counters updated on every state
+// change, so the accessors are O(1) and safe to call from the timer IRQ.
+//
+// Small requests are served from magazines: short stacks of blocks kept per
+// size class and per context. Code running with interrupts enabled uses the
+// task magazines and anything running with them disabled (interrupt
+// handlers, system calls) uses the IRQ ones. An interrupt never touches the
+// magazines of the code it interrupted, so the fast path needs no locking.
+// Everything behind the magazines runs with interrupts disabled.
 
 // Memory block header
 typedef struct mem_block {
     size_t size;
-    struct mem_block *next;
-    int free;
-} mem_block_t;
+    struct mem_block *prev; // Physically preceding block, NULL at heap start
+    uint16_t free;          // Block state (BLOCK_*)
+    uint16_t size_class;    // Index into size_classes, or SIZE_CLASS_NONE
+} __attribute__((aligned(8))) mem_block_t;
 
-// Start of the heap
-#define HEAP_START 0x100000  // 1MB mark
-#define HEAP_SIZE  0x10000   // 64KB for now
+// Free list links, kept in the payload of a free block
+typedef struct free_links {
+    mem_block_t *next;
+    mem_block_t *prev;
+} free_links_t;
 
-static mem_block_t *free_list = (mem_block_t*)HEAP_START;
+// Block states
+#define BLOCK_USED   0
+#define BLOCK_FREE   1      // Free on the first-fit list, can be merged
+#define BLOCK_CACHED 2      // Free, parked on its size class list
+
+// Smallest payload worth splitting off as a free block
+#define MIN_SPLIT sizeof(free_links_t)
+
+// Heap growth step; pages are only backed once touched
+#define HEAP_GROW_SIZE     0x40000   // 256KB
+// Free blocks at least this large give their pages back
+#define HEAP_DECOMMIT_MIN  0x10000   // 64KB
+
+// Size classes, roughly 1.25x apart
+static const uint16_t size_classes[] = {
+    16, 32, 48, 64, 80, 96, 128, 160, 192, 256,
+    320, 384, 512, 640, 768, 1024, 1280, 1536, 2048
+};
+
+#define NUM_SIZE_CLASSES   (sizeof(size_classes) / sizeof(size_classes[0]))
+#define SMALL_MAX          2048
+#define SIZE_CLASS_NONE    0xFFFF
+#define CLASS_REFILL_BYTES 4096   // Carved from the heap when a class runs dry
+
+// Size class for every 16-byte step up to SMALL_MAX
+static uint8_t class_index[(SMALL_MAX >> 4) + 1];
+
+// Free blocks of each class, linked through their payload
+static mem_block_t *class_free[NUM_SIZE_CLASSES];
+
+static mem_block_t *free_list = NULL;
+static mem_block_t *heap_fence = NULL;  // Fence block at the top of the heap
+static uint32_t heap_end = 0;           // Top of the committed heap range
+
+// Running statistics
+static size_t heap_used = 0;        // Payload bytes of allocated blocks
+static size_t heap_free = 0;        // Payload bytes of free and cached blocks
+static size_t heap_blocks = 0;      // Allocated blocks
+static size_t heap_peak = 0;        // High-water mark of heap_used
+static size_t heap_resident = 0;    // Heap bytes backed by frames
+
+// Allocation contexts
+#define CTX_TASK     0      // Interrupts enabled
+#define CTX_IRQ      1      // Interrupts disabled
+#define NUM_CONTEXTS 2
+
+// Magazines cover the size classes up to MAG_MAX_SIZE
+#define MAG_MAX_SIZE 256
+#define MAG_CLASSES  10     // Classes 16 to 256
+#define MAG_SIZE     16     // Blocks per magazine
+#define MAG_BATCH    (MAG_SIZE / 2)  // Blocks moved per refill or drain
+
+typedef struct magazine {
+    uint32_t count;
+    mem_block_t *blocks[MAG_SIZE];
+} magazine_t;
+
+static magazine_t magazines[NUM_CONTEXTS][MAG_CLASSES];
+
+// Blocks parked in magazines count as allocated in the heap counters above;
+// each context tracks its own so that no counter is shared between contexts
+static size_t mag_bytes[NUM_CONTEXTS];
+static size_t mag_blocks[NUM_CONTEXTS];
+
+// Block physically following `block`; the region fence ends the chain
+static inline mem_block_t *block_next(mem_block_t *block) {
+    return (mem_block_t*)((char*)(block + 1) + block->size);
+}
+
+static inline free_links_t *block_links(mem_block_t *block) {
+    return (free_links_t*)(block + 1);
+}
+
+// Free-list link kept in the payload of a cached block
+static inline mem_block_t **class_link(mem_block_t *block) {
+    return (mem_block_t**)(block + 1);
+}
+
+static void free_list_insert(mem_block_t *block) {
+    free_links_t *links = block_links(block);
+    links->prev = NULL;
+    links->next = free_list;
+    if (free_list) {
+        block_links(free_list)->prev = block;
+    }
+    free_list = block;
+    block->free = BLOCK_FREE;
+}
+
+static void free_list_remove(mem_block_t *block) {
+    free_links_t *links = block_links(block);
+    if (links->prev) {
+        block_links(links->prev)->next = links->next;
+    } else {
+        free_list = links->next;
+    }
+    if (links->next) {
+        block_links(links->next)->prev = links->prev;
+    }
+}
+
+// Back the heap page at `page` with a zeroed frame
+static bool heap_map_page(uint32_t page) {
+    uint32_t frame = zpool_alloc_frame();
+    if (!frame) return false;
+
+    if (!vmm_map(page, frame, PTE_WRITE | PTE_GLOBAL)) {
+        pmm_free_frame(frame);
+        return false;
+    }
+
+    heap_resident += PAGE_SIZE;
+    return true;
+}
+
+// Back the page holding `addr` without going through a fault; used where the
+// heap is written before the page fault handler is installed
+static bool heap_touch(void *addr) {
+    uint32_t page = (uint32_t)addr & ~(PAGE_SIZE - 1);
+    return vmm_translate(page) || heap_map_page(page);
+}
+
+// Extend the heap by at least `size` payload bytes. The old fence becomes a
+// free block covering the new space, merged into a free block before it.
+static mem_block_t *heap_grow(size_t size) {
+    size_t grow = (size + sizeof(mem_block_t) + HEAP_GROW_SIZE - 1) & ~(HEAP_GROW_SIZE - 1);
+    if (grow < size || grow > HEAP_VIRTUAL_END - heap_end) {
+        return NULL;
+    }
+
+    // Don't reserve more than the page frame allocator could back
+    if (grow > (size_t)pmm_get_free_frames() * PAGE_SIZE) {
+        return NULL;
+    }
+
+    mem_block_t *block = heap_fence;
+    mem_block_t *fence = (mem_block_t*)(heap_end + grow) - 1;
+    if (!heap_touch(fence)) {
+        return NULL;
+    }
+
+    heap_end += grow;
+    block->size = grow - sizeof(mem_block_t);
+    block->size_class = SIZE_CLASS_NONE;
+
+    fence->size = 0;
+    fence->prev = block;
+    fence->free = BLOCK_USED;
+    fence->size_class = SIZE_CLASS_NONE;
+    heap_fence = fence;
+    heap_free += block->size;
+
+    // Merge with a free block at the old top of the heap
+    if (block->prev && block->prev->free == BLOCK_FREE) {
+        mem_block_t *prev = block->prev;
+        free_list_remove(prev);
+        prev->size += sizeof(mem_block_t) + block->size;
+        heap_free += sizeof(mem_block_t);
+        block = prev;
+        fence->prev = block;
+    }
+
+    free_list_insert(block);
+    return block;
+}
+
+// Return the frames under [lo, hi) to the page frame allocator once that
+// range is part of the large free block `block`. Only pages wholly inside
+// the free block go, and the page holding its header and free list links
+// stays mapped. block_free() passes the block it freed plus any neighbour
+// it merged that was too small to be decommitted on its own; larger
+// neighbours were decommitted when they were freed. So the cost follows
+// the size of the freed block, not of the merged one.
+static void heap_decommit(mem_block_t *block, uint32_t lo, uint32_t hi) {
+    if (block->size < HEAP_DECOMMIT_MIN) return;
+
+    uint32_t start = ((uint32_t)(block_links(block) + 1) + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    uint32_t end = (uint32_t)block_next(block) & ~(PAGE_SIZE - 1);
+    lo &= ~(PAGE_SIZE - 1);
+    hi = (hi + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+    if (start < lo) start = lo;
+    if (end > hi) end = hi;
+    for (uint32_t page = start; page < end; page += PAGE_SIZE) {
+        uint32_t frame = vmm_unmap(page);
+        if (frame) {
+            pmm_free_frame(frame);
+            heap_resident -= PAGE_SIZE;
+        }
+    }
+}
+
+// Split the payload of a block after `size` bytes and put the rest on the
+// free list, merged with a free block after it
+static void block_trim(mem_block_t *block, size_t size) {
+    if (block->size < size + sizeof(mem_block_t) + MIN_SPLIT) return;
+
+    mem_block_t *tail = (mem_block_t*)((char*)(block + 1) + size);
+    tail->size = block->size - size - sizeof(mem_block_t);
+    tail->prev = block;
+    tail->size_class = SIZE_CLASS_NONE;
+    heap_free += tail->size;
+    block->size = size;
+
+    mem_block_t *next = block_next(tail);
+    if (next->free == BLOCK_FREE) {
+        free_list_remove(next);
+        tail->size += sizeof(mem_block_t) + next->size;
+        heap_free += sizeof(mem_block_t);
+    }
+
+    block_next(tail)->prev = tail;
+    free_list_insert(tail);
+}
+
+// Back a heap page on first touch; false when `addr` is not in the heap
+bool heap_handle_fault(uint32_t addr) {
+    if (addr < HEAP_VIRTUAL_START || addr >= heap_end) {
+        return false;
+    }
+    return heap_map_page(addr & ~(PAGE_SIZE - 1));
+}
 
 // Initialize the memory allocator
 void memory_init() {
-    free_list->size = HEAP_SIZE - sizeof(mem_block_t);
-    free_list->next = NULL;
-    free_list->free = 1;
+    pmm_init();
+    dma_init();
+#ifdef KMALLOC_PROFILE
+    heapprof_init();
+#endif
+    zpool_init();
+    slab_init();
+
+    uint32_t cls = 0;
+    for (uint32_t i = 0; i <= (SMALL_MAX >> 4); i++) {
+        while (size_classes[cls] < (i << 4)) {
+            cls++;
+        }
+        class_index[i] = cls;
+    }
+    for (uint32_t i = 0; i < NUM_SIZE_CLASSES; i++) {
+        class_free[i] = NULL;
+    }
+
+    memset(magazines, 0, sizeof(magazines));
+    memset(mag_bytes, 0, sizeof(mag_bytes));
+    memset(mag_blocks, 0, sizeof(mag_blocks));
+
+    free_list = NULL;
+    heap_used = 0;
+    heap_free = 0;
+    heap_blocks = 0;
+    heap_peak = 0;
+    heap_resident = 0;
+
+    // An empty heap is just its fence
+    heap_fence = (mem_block_t*)HEAP_VIRTUAL_START;
+    heap_end = HEAP_VIRTUAL_START + sizeof(mem_block_t);
+    if (!heap_touch(heap_fence)) {
+        panic("memory_init: cannot allocate the initial heap");
+    }
+    heap_fence->size = 0;
+    heap_fence->prev = NULL;
+    heap_fence->free = BLOCK_USED;
+    heap_fence->size_class = SIZE_CLASS_NONE;
+
+    if (!heap_grow(HEAP_GROW_SIZE - 2 * sizeof(mem_block_t))) {
+        panic("memory_init: cannot allocate the initial heap");
+    }
 }
 
-// Simple first-fit memory allocator
-void* kmalloc(size_t size) {
+// First-fit allocation for requests above SMALL_MAX and class refills
+static mem_block_t *large_alloc(size_t size) {
     // Round up to the nearest 8 bytes for alignment
     size = (size + 7) & ~7;
-    
+    if (size < MIN_SPLIT) {
+        size = MIN_SPLIT;
+    }
+
     mem_block_t *current = free_list;
-    mem_block_t *prev = NULL;
-    (void)prev;
-    
+
     // Find the first free block that's large enough
-    while (current) {
-        if (current->free && current->size >= size) {
-            // Can we split this block?
-            if (current->size > size + sizeof(mem_block_t)) {
-                // Split the block
-                mem_block_t *new_block = (mem_block_t*)((char*)current + sizeof(mem_block_t) + size);
-                new_block->size = current->size - size - sizeof(mem_block_t);
-                new_block->next = current->next;
-                new_block->free = 1;
-                
-                current->size = size;
-                current->next = new_block;
-            }
-            
-            current->free = 0;
-            return (void*)(current + 1);
+    while (current && current->size < size) {
+        current = block_links(current)->next;
+    }
+
+    // Out of space: grow the heap
+    if (!current) {
+        current = heap_grow(size);
+        if (!current) return NULL;
+    }
+
+    free_list_remove(current);
+    heap_free -= current->size;
+    current->free = BLOCK_USED;
+    current->size_class = SIZE_CLASS_NONE;
+
+    // Give back what the request does not need
+    block_trim(current, size);
+    return current;
+}
+
+// Carve a batch of blocks for an empty size class out of the heap
+static bool class_refill(uint32_t cls) {
+    size_t stride = sizeof(mem_block_t) + size_classes[cls];
+    size_t count = CLASS_REFILL_BYTES / stride;
+    if (count == 0) {
+        count = 1;
+    }
+
+    mem_block_t *block = large_alloc(count * stride - sizeof(mem_block_t));
+    if (!block) return false;
+    mem_block_t *start = block;
+
+    // Split it into `count` blocks; the last one keeps any slack left over
+    // by large_alloc()
+    mem_block_t *end = block_next(block);
+    mem_block_t *prev = block->prev;
+    for (size_t i = 0; i < count; i++) {
+        block->prev = prev;
+        block->size = (i == count - 1)
+            ? (size_t)((char*)end - (char*)(block + 1))
+            : size_classes[cls];
+        block->free = BLOCK_CACHED;
+        block->size_class = cls;
+        *class_link(block) = class_free[cls];
+        class_free[cls] = block;
+        prev = block;
+        block = block_next(block);
+    }
+    end->prev = prev;
+
+    // The batch is free space again, minus the headers carved into it
+    heap_free += (size_t)((char*)end - (char*)start) - count * sizeof(mem_block_t);
+
+    return true;
+}
+
+// Caller recorded by the profiler
+#ifdef KMALLOC_PROFILE
+#define ALLOC_CALLER __builtin_return_address(0)
+#else
+#define ALLOC_CALLER NULL
+#endif
+
+// Take a block for `size` bytes: O(1) for size classes, first-fit above
+// SMALL_MAX
+static mem_block_t *alloc_block(size_t size) {
+    if (size > SMALL_MAX) {
+        return large_alloc(size);
+    }
+
+    uint32_t cls = class_index[(size + 15) >> 4];
+    if (!class_free[cls] && !class_refill(cls)) {
+        return NULL;
+    }
+    mem_block_t *block = class_free[cls];
+    class_free[cls] = *class_link(block);
+    block->free = BLOCK_USED;
+    heap_free -= block->size;
+    return block;
+}
+
+// Account for a block leaving the heap
+static void block_account(mem_block_t *block) {
+    heap_used += block->size;
+    heap_blocks++;
+    if (heap_used > heap_peak) {
+        heap_peak = heap_used;
+    }
+}
+
+// Account for a block handed out to a caller
+static void *alloc_finish(mem_block_t *block, size_t size, void *caller) {
+    block_account(block);
+
+#ifdef KMALLOC_PROFILE
+    heapprof_alloc(block + 1, size, caller);
+#else
+    (void)size;
+    (void)caller;
+#endif
+
+    return (void*)(block + 1);
+}
+
+static void block_free(mem_block_t *block);
+
+// Context whose magazines the running code uses
+static inline uint32_t alloc_context(void) {
+    return irq_enabled() ? CTX_TASK : CTX_IRQ;
+}
+
+// Fill an empty magazine from the size class lists
+static bool mag_refill(uint32_t ctx, magazine_t *mag, uint32_t cls) {
+    uint32_t flags = irq_save();
+    while (mag->count < MAG_BATCH) {
+        mem_block_t *block = alloc_block(size_classes[cls]);
+        if (!block) break;
+        block_account(block);
+        mag->blocks[mag->count++] = block;
+        mag_bytes[ctx] += block->size;
+        mag_blocks[ctx]++;
+    }
+    irq_restore(flags);
+    return mag->count > 0;
+}
+
+// Return the top half of a full magazine to the size class lists
+static void mag_drain(uint32_t ctx, magazine_t *mag) {
+    uint32_t flags = irq_save();
+    while (mag->count > MAG_SIZE - MAG_BATCH) {
+        mem_block_t *block = mag->blocks[--mag->count];
+        mag_bytes[ctx] -= block->size;
+        mag_blocks[ctx]--;
+        block_free(block);
+    }
+    irq_restore(flags);
+}
+
+// Allocate a block too large for the magazines
+static void *large_heap_alloc(size_t size, void *caller) {
+    uint32_t flags = irq_save();
+    mem_block_t *block = alloc_block(size);
+    void *ptr = block ? alloc_finish(block, size, caller) : NULL;
+    irq_restore(flags);
+    return ptr;
+}
+
+// Allocate from the heap, through the magazines for small sizes. Failed
+// requests are retried once after reclaiming from the shrinkers.
+static void *heap_alloc(size_t size, void *caller) {
+    if (size > MAG_MAX_SIZE) {
+        void *ptr = large_heap_alloc(size, caller);
+        if (!ptr && shrink_memory(size + sizeof(mem_block_t))) {
+            ptr = large_heap_alloc(size, caller);
+        }
+        shrink_check_watermark();
+        return ptr;
+    }
+
+    uint32_t ctx = alloc_context();
+    uint32_t cls = class_index[(size + 15) >> 4];
+    magazine_t *mag = &magazines[ctx][cls];
+    if (mag->count == 0) {
+        if (!mag_refill(ctx, mag, cls) &&
+            !(shrink_memory(CLASS_REFILL_BYTES) && mag_refill(ctx, mag, cls))) {
+            return NULL;
+        }
+        shrink_check_watermark();
+    }
+
+    mem_block_t *block = mag->blocks[--mag->count];
+    mag_bytes[ctx] -= block->size;
+    mag_blocks[ctx]--;
+
+#ifdef KMALLOC_PROFILE
+    uint32_t flags = irq_save();
+    heapprof_alloc(block + 1, size, caller);
+    irq_restore(flags);
+#else
+    (void)caller;
+#endif
+
+    return (void*)(block + 1);
+}
+
+// Allocate memory
+void* kmalloc(size_t size) {
+    return heap_alloc(size, ALLOC_CALLER);
+}
+
+// Allocate memory aligned to `align`, a power of two
+void* kmalloc_aligned(size_t size, size_t align) {
+    if (align == 0 || (align & (align - 1)) || align > HEAP_GROW_SIZE) {
+        return NULL;
+    }
+
+    // Every block is 8-byte aligned already
+    if (align <= 8) {
+        return heap_alloc(size, ALLOC_CALLER);
+    }
+
+    size = (size + 7) & ~7;
+    if (size < MIN_SPLIT) {
+        size = MIN_SPLIT;
+    }
+
+    // Room for the payload at any alignment with a free block in front of it
+    size_t need = size + align + sizeof(mem_block_t) + MIN_SPLIT;
+    uint32_t flags = irq_save();
+    mem_block_t *block = large_alloc(need);
+    if (!block) {
+        // Reclaim needs interrupts back on
+        irq_restore(flags);
+        if (!shrink_memory(need + sizeof(mem_block_t))) return NULL;
+
+        flags = irq_save();
+        block = large_alloc(need);
+        if (!block) {
+            irq_restore(flags);
+            return NULL;
         }
-        prev = current;
-        current = current->next;
     }
-    
-    // No suitable block found
-    return NULL;
+
+    uint32_t payload = (uint32_t)(block + 1);
+    if (payload & (align - 1)) {
+        uint32_t aligned = (payload + sizeof(mem_block_t) + MIN_SPLIT + align - 1) & ~(align - 1);
+        mem_block_t *aligned_block = (mem_block_t*)aligned - 1;
+        aligned_block->size = block->size - (aligned - payload);
+        aligned_block->prev = block;
+        aligned_block->free = BLOCK_USED;
+        aligned_block->size_class = SIZE_CLASS_NONE;
+        block_next(aligned_block)->prev = aligned_block;
+
+        // The gap becomes a free block; its neighbours are in use, since
+        // large_alloc() took `block` from the free list
+        block->size = (uint32_t)aligned_block - payload;
+        free_list_insert(block);
+        heap_free += block->size;
+        block = aligned_block;
+    }
+
+    block_trim(block, size);
+    void *ptr = alloc_finish(block, size, ALLOC_CALLER);
+    irq_restore(flags);
+    return ptr;
+}
+
+// Resize an allocated block in place, absorbing the free block after it
+// and growing the heap when the block sits at the top. Returns false when
+// the block has to move.
+static bool block_resize(mem_block_t *block, size_t size) {
+    if (block->size_class != SIZE_CLASS_NONE) {
+        return size <= block->size;
+    }
+
+    size = (size + 7) & ~7;
+    if (size < MIN_SPLIT) {
+        size = MIN_SPLIT;
+    }
+
+    size_t old_size = block->size;
+    if (size > old_size) {
+        mem_block_t *next = block_next(block);
+        if (next == heap_fence) {
+            next = heap_grow(size - old_size);
+            if (!next) return false;
+        }
+        if (next->free != BLOCK_FREE ||
+            old_size + sizeof(mem_block_t) + next->size < size) {
+            return false;
+        }
+
+        free_list_remove(next);
+        heap_free -= next->size;
+        block->size += sizeof(mem_block_t) + next->size;
+        block_next(block)->prev = block;
+    }
+
+    // Give back what the new size does not need
+    block_trim(block, size);
+    heap_used = heap_used - old_size + block->size;
+    if (heap_used > heap_peak) {
+        heap_peak = heap_used;
+    }
+    return true;
+}
+
+// Resize an allocation
+void* krealloc(void *ptr, size_t size) {
+    if (!ptr) {
+        return heap_alloc(size, ALLOC_CALLER);
+    }
+    if (size == 0) {
+        kfree(ptr);
+        return NULL;
+    }
+
+    mem_block_t *block = (mem_block_t*)ptr - 1;
+    uint32_t flags = irq_save();
+    bool resized = block_resize(block, size);
+#ifdef KMALLOC_PROFILE
+    if (resized) {
+        heapprof_free(ptr);
+        heapprof_alloc(ptr, size, ALLOC_CALLER);
+    }
+#endif
+    irq_restore(flags);
+    if (resized) {
+        return ptr;
+    }
+
+    // Move the data to a new block
+    void *new_ptr = heap_alloc(size, ALLOC_CALLER);
+    if (!new_ptr) return NULL;
+    memcpy(new_ptr, ptr, block->size < size ? block->size : size);
+    kfree(ptr);
+    return new_ptr;
 }
 
 // Free allocated memory
 void kfree(void *ptr) {
     if (!ptr) return;
-    
+
+#ifdef KMALLOC_PROFILE
+    uint32_t prof_flags = irq_save();
+    heapprof_free(ptr);
+    irq_restore(prof_flags);
+#endif
+
     mem_block_t *block = (mem_block_t*)ptr - 1;
-    block->free = 1;
-    
-    // Merge with next block if it's free
-    if (block->next && block->next->free) {
-        block->size += block->next->size + sizeof(mem_block_t);
-        block->next = block->next->next;
+    if (block->size_class < MAG_CLASSES) {
+        uint32_t ctx = alloc_context();
+        magazine_t *mag = &magazines[ctx][block->size_class];
+        if (mag->count == MAG_SIZE) {
+            mag_drain(ctx, mag);
+        }
+        mag->blocks[mag->count++] = block;
+        mag_bytes[ctx] += block->size;
+        mag_blocks[ctx]++;
+        return;
     }
+
+    uint32_t flags = irq_save();
+    block_free(block);
+    irq_restore(flags);
 }
 
-// Get the total free memory in bytes
-size_t get_free_memory() {
-    size_t free_mem = 0;
-    mem_block_t *current = free_list;
-    
-    while (current) {
-        if (current->free) {
-            free_mem += current->size;
+// Return a block to the heap
+static void block_free(mem_block_t *block) {
+    heap_used -= block->size;
+    heap_free += block->size;
+    heap_blocks--;
+
+    // Size class blocks go back on their list in O(1)
+    if (block->size_class != SIZE_CLASS_NONE) {
+        block->free = BLOCK_CACHED;
+        *class_link(block) = class_free[block->size_class];
+        class_free[block->size_class] = block;
+        return;
+    }
+
+    // The memory this block covered, for heap_decommit(). A merged
+    // neighbour below HEAP_DECOMMIT_MIN kept its pages when it was freed,
+    // so the range takes it in too; that is at most 16 pages each.
+    uint32_t lo = (uint32_t)block;
+    uint32_t hi = (uint32_t)block_next(block);
+
+    // Merge with the following block
+    mem_block_t *next = block_next(block);
+    if (next->free == BLOCK_FREE) {
+        free_list_remove(next);
+        if (next->size < HEAP_DECOMMIT_MIN) {
+            hi = (uint32_t)block_next(next);
+        } else {
+            hi = (uint32_t)(block_links(next) + 1);    // Its header is free now too
+        }
+        block->size += sizeof(mem_block_t) + next->size;
+        heap_free += sizeof(mem_block_t);
+    }
+
+    // Merge into the preceding block
+    if (block->prev && block->prev->free == BLOCK_FREE) {
+        mem_block_t *prev = block->prev;
+        free_list_remove(prev);
+        if (prev->size < HEAP_DECOMMIT_MIN) {
+            lo = (uint32_t)prev;
         }
-        current = current->next;
+        prev->size += sizeof(mem_block_t) + block->size;
+        heap_free += sizeof(mem_block_t);
+        block = prev;
     }
-    
-    return free_mem;
+
+    block_next(block)->prev = block;
+    free_list_insert(block);
+    heap_decommit(block, lo, hi);
+}
+
+// Get the free memory in bytes: unallocated frames plus resident heap pages
+// that hold no allocations
+size_t get_free_memory() {
+    size_t used = get_used_memory();
+    size_t idle = heap_resident > used ? heap_resident - used : 0;
+    return idle + (size_t)pmm_get_free_frames() * PAGE_SIZE;
 }
 
-// Get the total memory pool size in bytes
+// Get the total memory available to the heap in bytes
 size_t get_total_memory() {
-    return HEAP_SIZE;
+    return (size_t)pmm_get_total_frames() * PAGE_SIZE;
 }
 
 // Get the used memory in bytes
 size_t get_used_memory() {
-    size_t used_mem = 0;
-    mem_block_t *current = free_list;
-    
-    while (current) {
-        if (!current->free) {
-            used_mem += current->size;
+    return heap_used - mag_bytes[CTX_TASK] - mag_bytes[CTX_IRQ];
+}
+
+// Get the highest used memory seen since boot in bytes, counting blocks
+// parked in magazines as used
+size_t get_peak_memory() {
+    return heap_peak;
+}
+
+// Get the number of live allocations
+size_t get_allocation_count() {
+    return heap_blocks - mag_blocks[CTX_TASK] - mag_blocks[CTX_IRQ];
+}
+
+// Get the size of the virtual range set aside for the heap in bytes
+size_t get_heap_reserved() {
+    return HEAP_VIRTUAL_END - HEAP_VIRTUAL_START;
+}
+
+// Get the part of the reserved range the heap has grown into in bytes
+size_t get_heap_committed() {
+    return heap_end - HEAP_VIRTUAL_START;
+}
+
+// Get the heap bytes backed by physical frames
+size_t get_heap_resident() {
+    return heap_resident;
+}
+
+// Get the free bytes inside the committed heap, resident or not
+size_t get_heap_free() {
+    return heap_free + mag_bytes[CTX_TASK] + mag_bytes[CTX_IRQ];
+}
+
+// Get the largest block on the heap free list in bytes
+size_t get_largest_free_block() {
+    size_t largest = 0;
+
+    uint32_t flags = irq_save();
+    for (mem_block_t *block = free_list; block; block = block_links(block)->next) {
+        if (block->size > largest) {
+            largest = block->size;
         }
-        current = current->next;
     }
-    
-    return used_mem;
+    irq_restore(flags);
+
+    return largest;
 }
 
+// Get heap fragmentation in percent: 0 when all free heap space is one block
+uint32_t get_heap_fragmentation() {
+    size_t total = 0;
+    size_t largest = 0;
+
+    uint32_t flags = irq_save();
+    for (mem_block_t *block = free_list; block; block = block_links(block)->next) {
+        total += block->size;
+        if (block->size > largest) {
+            largest = block->size;
+        }
+    }
+    irq_restore(flags);
+
+    if (total < 100) {
+        return 0;
+    }
+
+    uint32_t contiguous = largest / (total / 100);
+    if (contiguous > 100) {
+        contiguous = 100;
+    }
+    return 100 - contiguous;
+}
@@ -2,6 +2,8 @@
 #define KERNEL_MEMORY_H
 
 #include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
 
 // Initialize the memory manager
 void memory_init(void);
@@ -10,6 +12,14 @@ void memory_init(void);
 void* kmalloc(size_t size);
 void kfree(void* ptr);
 
+// Allocate memory aligned to `align` (a power of two), freed with kfree().
+// The block is virtually contiguous only; see dma.h for device buffers.
+void* kmalloc_aligned(size_t size, size_t align);
+
+// Resize an allocation, in place when the block or the free block after it
+// has room. Returns NULL and leaves `ptr` alone when out of memory.
+void* krealloc(void* ptr, size_t size);
+
 // Get the total free memory in bytes
 size_t get_free_memory(void);
 
@@ -19,4 +29,28 @@ size_t get_total_memory(void);
 // Get the used memory in bytes
 size_t get_used_memory(void);
 
+// Get the highest used memory seen since boot in bytes
+size_t get_peak_memory(void);
+
+// Get the number of live allocations
+size_t get_allocation_count(void);
+
+// Heap address space: the virtual range set aside for the heap, the part it
+// has grown into, and the bytes of that actually backed by frames
+size_t get_heap_reserved(void);
+size_t get_heap_committed(void);
+size_t get_heap_resident(void);
+
+// Get the free bytes inside the committed heap
+size_t get_heap_free(void);
+
+// Get the largest free block on the heap in bytes
+size_t get_largest_free_block(void);
+
+// Get heap fragmentation in percent: 100 - largest free block / total free
+uint32_t get_heap_fragmentation(void);
+
+// Back a heap page on first touch; called by the page fault handler
+bool heap_handle_fault(uint32_t addr);
+
 #endif // KERNEL_MEMORY_H
@@ -0,0 +1,335 @@
+#include "pmm.h"
+#include "kernel.h"
+#include "vmm.h"
+#include "util.h"
+#include "../bios/bios.h"
+
+// Physical page frame allocator
+// A binary buddy allocator over every usable E820 region. Free blocks of each
+// order are kept on doubly linked lists threaded through the frame table, so
+// allocation and free touch at most PMM_MAX_ORDER lists: O(log n).
+// The lists are only changed with interrupts disabled, so frames can be
+// allocated and freed from interrupt handlers.
+
+// Per-frame bookkeeping
+typedef struct page {
+    uint32_t next;      // Next free block of the same order (frame number)
+    uint32_t prev;      // Previous free block of the same order
+    uint8_t order;      // Order of the block this frame heads
+    uint8_t flags;
+    uint16_t shares;    // Mappings beyond the first, for copy-on-write
+} page_t;
+
+#define PAGE_FREE     0x01  // Frame heads a free block
+#define PAGE_RESERVED 0x02  // Frame is never handed out
+
+#define FRAME_NONE 0xFFFFFFFF
+
+// End of the kernel image (linker.ld), a higher-half address
+extern char _kernel_end[];
+
+static page_t *pages = NULL;
+static uint32_t nframes = 0;
+static uint32_t free_area[PMM_MAX_ORDER + 1];
+static uint32_t total_frames = 0;
+static uint32_t free_frames = 0;
+static uint32_t shared_frames = 0;
+
+// Unlink a free block from its order list
+static void free_list_remove(uint32_t frame, uint32_t order) {
+    page_t *page = &pages[frame];
+
+    if (page->prev != FRAME_NONE) {
+        pages[page->prev].next = page->next;
+    } else {
+        free_area[order] = page->next;
+    }
+    if (page->next != FRAME_NONE) {
+        pages[page->next].prev = page->prev;
+    }
+    page->flags &= ~PAGE_FREE;
+}
+
+// Push a block on the free list of its order
+static void free_list_add(uint32_t frame, uint32_t order) {
+    page_t *page = &pages[frame];
+
+    page->order = order;
+    page->flags |= PAGE_FREE;
+    page->prev = FRAME_NONE;
+    page->next = free_area[order];
+    if (page->next != FRAME_NONE) {
+        pages[page->next].prev = frame;
+    }
+    free_area[order] = frame;
+}
+
+// Return a block to the free lists, merging with its buddy while possible
+static void buddy_free(uint32_t frame, uint32_t order) {
+    free_frames += 1 << order;
+
+    while (order < PMM_MAX_ORDER) {
+        uint32_t buddy = frame ^ (1 << order);
+        if (buddy >= nframes ||
+            !(pages[buddy].flags & PAGE_FREE) ||
+            pages[buddy].order != order) {
+            break;
+        }
+        free_list_remove(buddy, order);
+        if (buddy < frame) {
+            frame = buddy;
+        }
+        order++;
+    }
+
+    free_list_add(frame, order);
+}
+
+// Hand the frames [start, end) to the buddy allocator in aligned blocks
+static void free_range(uint32_t start, uint32_t end) {
+    while (start < end) {
+        uint32_t order = PMM_MAX_ORDER;
+        while (order > 0 &&
+               ((start & ((1 << order) - 1)) != 0 || start + (1 << order) > end)) {
+            order--;
+        }
+
+        for (uint32_t i = 0; i < (1U << order); i++) {
+            pages[start + i].flags &= ~PAGE_RESERVED;
+        }
+        total_frames += 1 << order;
+        buddy_free(start, order);
+        start += 1 << order;
+    }
+}
+
+// Usable part of an E820 entry as whole frames inside the direct map
+static bool e820_frames(const e820_entry_t *entry, uint32_t *start, uint32_t *end) {
+    if (entry->type != E820_RAM || entry->base >= DIRECT_MAP_SIZE) {
+        return false;
+    }
+
+    uint64_t base = entry->base;
+    uint64_t top = entry->base + entry->length;
+    if (top > DIRECT_MAP_SIZE) {
+        top = DIRECT_MAP_SIZE;
+    }
+
+    *start = (uint32_t)((base + PAGE_SIZE - 1) >> PAGE_SHIFT);
+    *end = (uint32_t)(top >> PAGE_SHIFT);
+    return *start < *end;
+}
+
+// Initialize the page frame allocator from the E820 map
+void pmm_init(void) {
+    uint32_t num_entries = *(uint32_t*)PHYS_TO_VIRT(E820_MAP_ADDR);
+    e820_entry_t *mem_map = (e820_entry_t*)PHYS_TO_VIRT(E820_ENTRIES_ADDR);
+
+    // Without a map, assume conventional memory plus 1 MB above the 1 MB mark
+    static e820_entry_t fallback_map[2] = {
+        { 0x00000000, 0x0009F000, E820_RAM, 0 },
+        { 0x00100000, 0x00100000, E820_RAM, 0 },
+    };
+    if (num_entries == 0) {
+        num_entries = 2;
+        mem_map = fallback_map;
+    }
+
+    // Size the frame table to cover the highest usable frame
+    uint32_t start, end;
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (e820_frames(&mem_map[i], &start, &end) && end > nframes) {
+            nframes = end;
+        }
+    }
+
+    // Place the frame table in the first RAM above 1 MB that can hold it
+    uint32_t table_frames = (nframes * sizeof(page_t) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    uint32_t table_start = 0;
+    for (uint32_t i = 0; i < num_entries && !table_start; i++) {
+        if (!e820_frames(&mem_map[i], &start, &end)) continue;
+        if (start < (0x100000 >> PAGE_SHIFT)) {
+            start = 0x100000 >> PAGE_SHIFT;
+        }
+        if (start + table_frames <= end) {
+            table_start = start;
+        }
+    }
+    if (!table_start) {
+        panic("pmm: no room for the frame table");
+    }
+
+    pages = (page_t*)PHYS_TO_VIRT(table_start << PAGE_SHIFT);
+    for (uint32_t i = 0; i < nframes; i++) {
+        pages[i].next = FRAME_NONE;
+        pages[i].prev = FRAME_NONE;
+        pages[i].order = 0;
+        pages[i].flags = PAGE_RESERVED;
+        pages[i].shares = 0;
+    }
+    for (uint32_t i = 0; i <= PMM_MAX_ORDER; i++) {
+        free_area[i] = FRAME_NONE;
+    }
+
+    // Ranges that must never be handed out, sorted by start frame
+    uint32_t kernel_end = (VIRT_TO_PHYS(_kernel_end) + PAGE_SIZE - 1) >> PAGE_SHIFT;
+    struct { uint32_t start, end; } reserved[] = {
+        { 0, 0x8000 >> PAGE_SHIFT },                          // IVT, BDA, E820 map, boot sector
+        { 0x8000 >> PAGE_SHIFT, kernel_end },                 // Kernel image
+        { INITRD_ADDRESS >> PAGE_SHIFT,
+          (INITRD_ADDRESS + INITRD_MAX_SIZE) >> PAGE_SHIFT }, // Initial ramdisk
+        { (BOOT_STACK_TOP - BOOT_STACK_SIZE) >> PAGE_SHIFT,
+          BOOT_STACK_TOP >> PAGE_SHIFT },                     // Boot stack
+        { 0xA0000 >> PAGE_SHIFT, 0x100000 >> PAGE_SHIFT },    // VGA hole and BIOS ROM
+        { table_start, table_start + table_frames },          // Frame table
+    };
+    const uint32_t num_reserved = sizeof(reserved) / sizeof(reserved[0]);
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (!e820_frames(&mem_map[i], &start, &end)) continue;
+
+        uint32_t cursor = start;
+        for (uint32_t r = 0; r < num_reserved && cursor < end; r++) {
+            if (reserved[r].end <= cursor) continue;
+            if (reserved[r].start >= end) break;
+            if (reserved[r].start > cursor) {
+                free_range(cursor, reserved[r].start);
+            }
+            cursor = reserved[r].end;
+        }
+        if (cursor < end) {
+            free_range(cursor, end);
+        }
+    }
+}
+
+// Take the free block at `frame` of order `current` and split it down to
+// `order`, returning the upper halves to the free lists
+static uint32_t take_block(uint32_t frame, uint32_t current, uint32_t order) {
+    free_list_remove(frame, current);
+
+    while (current > order) {
+        current--;
+        free_list_add(frame + (1 << current), current);
+    }
+
+    pages[frame].order = order;
+    free_frames -= 1 << order;
+    return frame << PAGE_SHIFT;
+}
+
+// Allocate 2^order contiguous frames
+uint32_t pmm_alloc_pages(uint32_t order) {
+    if (order > PMM_MAX_ORDER) return 0;
+
+    uint32_t flags = irq_save();
+    uint32_t addr = 0;
+
+    // Find the smallest non-empty list that fits
+    uint32_t current = order;
+    while (current <= PMM_MAX_ORDER && free_area[current] == FRAME_NONE) {
+        current++;
+    }
+    if (current <= PMM_MAX_ORDER) {
+        addr = take_block(free_area[current], current, order);
+    }
+
+    irq_restore(flags);
+    return addr;
+}
+
+// Allocate 2^order contiguous frames ending at or below `limit`
+uint32_t pmm_alloc_pages_below(uint32_t order, uint32_t limit) {
+    if (order > PMM_MAX_ORDER) return 0;
+
+    // Splitting keeps the lowest part of a block, so any free block that
+    // starts low enough will do; the lists are not sorted, so search them
+    uint32_t max_frame = limit >> PAGE_SHIFT;
+    uint32_t flags = irq_save();
+    uint32_t addr = 0;
+    for (uint32_t current = order; current <= PMM_MAX_ORDER && !addr; current++) {
+        for (uint32_t frame = free_area[current]; frame != FRAME_NONE; frame = pages[frame].next) {
+            if (frame + (1 << order) <= max_frame) {
+                addr = take_block(frame, current, order);
+                break;
+            }
+        }
+    }
+    irq_restore(flags);
+    return addr;
+}
+
+// Free a block returned by pmm_alloc_pages()
+void pmm_free_pages(uint32_t addr) {
+    uint32_t frame = addr >> PAGE_SHIFT;
+    if (!addr || frame >= nframes) return;
+
+    page_t *page = &pages[frame];
+    if (page->flags & (PAGE_FREE | PAGE_RESERVED)) return;  // Double free or bogus address
+
+    uint32_t flags = irq_save();
+    buddy_free(frame, page->order);
+    irq_restore(flags);
+}
+
+uint32_t pmm_alloc_frame(void) {
+    return pmm_alloc_pages(0);
+}
+
+void pmm_free_frame(uint32_t addr) {
+    pmm_free_pages(addr);
+}
+
+// Record one more mapping of an allocated frame
+void pmm_frame_share(uint32_t addr) {
+    uint32_t frame = addr >> PAGE_SHIFT;
+    if (frame >= nframes) return;
+
+    uint32_t flags = irq_save();
+    if (pages[frame].shares++ == 0) {
+        shared_frames++;
+    }
+    irq_restore(flags);
+}
+
+// Drop one mapping of a frame, freeing it with the last one
+void pmm_frame_release(uint32_t addr) {
+    uint32_t frame = addr >> PAGE_SHIFT;
+    if (frame >= nframes) return;
+
+    uint32_t flags = irq_save();
+    if (pages[frame].shares) {
+        if (--pages[frame].shares == 0) {
+            shared_frames--;
+        }
+    } else {
+        pmm_free_pages(addr);
+    }
+    irq_restore(flags);
+}
+
+bool pmm_frame_is_shared(uint32_t addr) {
+    uint32_t frame = addr >> PAGE_SHIFT;
+    return frame < nframes && pages[frame].shares != 0;
+}
+
+// Smallest order whose block holds `size` bytes
+uint32_t pmm_order_for_size(uint32_t size) {
+    uint32_t order = 0;
+    while (order < PMM_MAX_ORDER && ((uint32_t)PAGE_SIZE << order) < size) {
+        order++;
+    }
+    return order;
+}
+
+uint32_t pmm_get_total_frames(void) {
+    return total_frames;
+}
+
+uint32_t pmm_get_free_frames(void) {
+    return free_frames;
+}
+
+uint32_t pmm_get_shared_frames(void) {
+    return shared_frames;
+}
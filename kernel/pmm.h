@@ -0,0 +1,54 @@
+#ifndef KERNEL_PMM_H
+#define KERNEL_PMM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Page frame geometry
+#define PAGE_SIZE       4096
+#define PAGE_SHIFT      12
+
+// Largest buddy block is 2^PMM_MAX_ORDER frames (4 MB)
+#define PMM_MAX_ORDER   10
+
+// Physical memory layout left behind by boot.asm
+#define INITRD_ADDRESS  0x60000   // Initial ramdisk load address
+#define INITRD_MAX_SIZE 0x10000   // Window reserved for the initrd
+#define BOOT_STACK_TOP  0x90000   // Kernel stack grows down from here
+#define BOOT_STACK_SIZE 0x10000
+
+// Initialize the page frame allocator from the E820 map
+void pmm_init(void);
+
+// Allocate 2^order physically contiguous frames, aligned to their size.
+// Returns the physical address of the first frame, or 0 on failure; the
+// kernel reaches it through PHYS_TO_VIRT().
+uint32_t pmm_alloc_pages(uint32_t order);
+
+// Allocate 2^order frames that all lie below the physical address `limit`.
+// Searches the free lists, so it is slower than pmm_alloc_pages().
+uint32_t pmm_alloc_pages_below(uint32_t order, uint32_t limit);
+
+// Free a block returned by pmm_alloc_pages() or pmm_alloc_pages_below()
+void pmm_free_pages(uint32_t addr);
+
+// Single frame helpers
+uint32_t pmm_alloc_frame(void);
+void pmm_free_frame(uint32_t addr);
+
+// Copy-on-write sharing of single frames. A frame starts with one owner;
+// every pmm_frame_share() adds a mapping that must be dropped with
+// pmm_frame_release(), which frees the frame when the last one goes.
+void pmm_frame_share(uint32_t addr);
+void pmm_frame_release(uint32_t addr);
+bool pmm_frame_is_shared(uint32_t addr);
+
+// Smallest order whose block holds `size` bytes
+uint32_t pmm_order_for_size(uint32_t size);
+
+// Frame counts
+uint32_t pmm_get_total_frames(void);
+uint32_t pmm_get_free_frames(void);
+uint32_t pmm_get_shared_frames(void);   // Frames mapped more than once
+
+#endif // KERNEL_PMM_H
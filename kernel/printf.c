@@ -0,0 +1,275 @@
+#include "printf.h"
+#include "terminal.h"
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Single-pass formatter
+// Literal text is handed to the sink as one piece per run, and numbers are
+// built backwards in a small buffer on the stack, so nothing is rescanned
+// and no intermediate string is needed.
+
+// Longest conversion body: 20 decimal digits of a 64-bit value
+#define NUM_BUF 24
+
+static const char digit_pairs[201] =
+    "00010203040506070809"
+    "10111213141516171819"
+    "20212223242526272829"
+    "30313233343536373839"
+    "40414243444546474849"
+    "50515253545556575859"
+    "60616263646566676869"
+    "70717273747576777879"
+    "80818283848586878889"
+    "90919293949596979899";
+
+static const char hex_lower[] = "0123456789abcdef";
+static const char hex_upper[] = "0123456789ABCDEF";
+
+// Divide `*v` by 100 in place and return the remainder. Two 32-bit divl
+// instructions stand in for a 64-bit division, which would need libgcc.
+static uint32_t divmod100(uint64_t *v) {
+    uint32_t hi = (uint32_t)(*v >> 32);
+    uint32_t lo = (uint32_t)*v;
+    uint32_t rem = hi % 100;
+    hi /= 100;
+    asm ("divl %4" : "=a"(lo), "=d"(rem) : "0"(lo), "1"(rem), "r"(100U));
+    *v = ((uint64_t)hi << 32) | lo;
+    return rem;
+}
+
+// Write `v` in decimal ending just before `end`, two digits per step.
+// Returns the first digit.
+static char *format_dec(char *end, uint64_t v) {
+    while (v >= 100) {
+        uint32_t pair = divmod100(&v) * 2;
+        end -= 2;
+        end[0] = digit_pairs[pair];
+        end[1] = digit_pairs[pair + 1];
+    }
+    if (v >= 10) {
+        end -= 2;
+        end[0] = digit_pairs[(uint32_t)v * 2];
+        end[1] = digit_pairs[(uint32_t)v * 2 + 1];
+    } else {
+        *--end = '0' + (uint32_t)v;
+    }
+    return end;
+}
+
+static char *format_hex(char *end, uint64_t v, const char *digits) {
+    do {
+        *--end = digits[v & 0xF];
+        v >>= 4;
+    } while (v);
+    return end;
+}
+
+// Emit `count` copies of `c`, which is ' ' or '0'
+static void emit_pad(kprintf_sink_t sink, void *ctx, char c, int count) {
+    static const char spaces[] = "                ";
+    static const char zeros[] = "0000000000000000";
+    const char *run = c == '0' ? zeros : spaces;
+    while (count > 0) {
+        int n = count < 16 ? count : 16;
+        sink(ctx, run, n);
+        count -= n;
+    }
+}
+
+int kvprintf(kprintf_sink_t sink, void *ctx, const char *fmt, va_list args) {
+    int total = 0;
+
+    while (*fmt) {
+        const char *literal = fmt;
+        while (*fmt && *fmt != '%') {
+            fmt++;
+        }
+        if (fmt > literal) {
+            sink(ctx, literal, fmt - literal);
+            total += fmt - literal;
+        }
+        if (!*fmt) break;
+        fmt++;
+
+        bool left = false;
+        char pad = ' ';
+        for (;; fmt++) {
+            if (*fmt == '-') {
+                left = true;
+            } else if (*fmt == '0') {
+                pad = '0';
+            } else {
+                break;
+            }
+        }
+
+        int width = 0;
+        if (*fmt == '*') {
+            width = va_arg(args, int);
+            if (width < 0) {
+                left = true;
+                width = -width;
+            }
+            fmt++;
+        } else {
+            while (*fmt >= '0' && *fmt <= '9') {
+                width = width * 10 + (*fmt++ - '0');
+            }
+        }
+
+        int precision = -1;
+        if (*fmt == '.') {
+            fmt++;
+            precision = 0;
+            if (*fmt == '*') {
+                precision = va_arg(args, int);
+                fmt++;
+            } else {
+                while (*fmt >= '0' && *fmt <= '9') {
+                    precision = precision * 10 + (*fmt++ - '0');
+                }
+            }
+        }
+
+        int longs = 0;
+        while (*fmt == 'l') {
+            longs++;
+            fmt++;
+        }
+        if (*fmt == 'z') {
+            fmt++;
+        }
+
+        char buf[NUM_BUF];
+        char *digits = buf + sizeof(buf);
+        const char *str;
+        const char *end = digits;
+        const char *prefix = "";
+        bool numeric = true;
+        uint64_t u;
+
+        switch (*fmt) {
+        case 'd':
+        case 'i': {
+            int64_t v = longs >= 2 ? va_arg(args, int64_t) : va_arg(args, int);
+            u = v < 0 ? -(uint64_t)v : (uint64_t)v;
+            if (v < 0) prefix = "-";
+            str = format_dec(digits, u);
+            break;
+        }
+        case 'u':
+            u = longs >= 2 ? va_arg(args, uint64_t) : va_arg(args, unsigned int);
+            str = format_dec(digits, u);
+            break;
+        case 'x':
+        case 'X':
+            u = longs >= 2 ? va_arg(args, uint64_t) : va_arg(args, unsigned int);
+            str = format_hex(digits, u, *fmt == 'x' ? hex_lower : hex_upper);
+            break;
+        case 'p':
+            digits = format_hex(digits, (uintptr_t)va_arg(args, void*), hex_lower);
+            while (end - digits < 8) {
+                *--digits = '0';
+            }
+            str = digits;
+            prefix = "0x";
+            break;
+        case 'c':
+            buf[0] = (char)va_arg(args, int);
+            str = buf;
+            end = buf + 1;
+            numeric = false;
+            break;
+        case 's':
+            str = va_arg(args, const char*);
+            if (!str) str = "(null)";
+            if (precision >= 0) {
+                end = memchr(str, '\0', precision);
+                if (!end) end = str + precision;
+            } else {
+                end = str + strlen(str);
+            }
+            numeric = false;
+            break;
+        case '\0':
+            // A lone '%' at the end of the format
+            return total;
+        default:
+            // Unknown conversions, and "%%", print the character itself
+            buf[0] = *fmt;
+            str = buf;
+            end = buf + 1;
+            numeric = false;
+            break;
+        }
+        fmt++;
+
+        int len = end - str;
+        int prefix_len = strlen(prefix);
+        int fill = width - len - prefix_len;
+
+        if (!left && !(numeric && pad == '0')) {
+            emit_pad(sink, ctx, ' ', fill);
+        }
+        if (prefix_len) {
+            sink(ctx, prefix, prefix_len);
+        }
+        if (!left && numeric && pad == '0') {
+            emit_pad(sink, ctx, '0', fill);
+        }
+        sink(ctx, str, len);
+        if (left) {
+            emit_pad(sink, ctx, ' ', fill);
+        }
+        total += (fill > 0 ? fill : 0) + prefix_len + len;
+    }
+
+    return total;
+}
+
+// Output collected into a caller's buffer
+typedef struct {
+    char *buf;
+    size_t room;    // Bytes left for text, the terminator excluded
+} buf_sink_t;
+
+static void buf_write(void *ctx, const char *data, size_t len) {
+    buf_sink_t *sink = (buf_sink_t*)ctx;
+    if (len > sink->room) {
+        len = sink->room;
+    }
+    memcpy(sink->buf, data, len);
+    sink->buf += len;
+    sink->room -= len;
+}
+
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args) {
+    char discard;
+    buf_sink_t sink = { size ? buf : &discard, size ? size - 1 : 0 };
+    int len = kvprintf(buf_write, &sink, fmt, args);
+    *sink.buf = '\0';
+    return len;
+}
+
+int ksnprintf(char *buf, size_t size, const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = kvsnprintf(buf, size, fmt, args);
+    va_end(args);
+    return len;
+}
+
+static void terminal_sink(void *ctx, const char *data, size_t len) {
+    (void)ctx;
+    terminal_write(data, len);
+}
+
+int kprintf(const char *fmt, ...) {
+    va_list args;
+    va_start(args, fmt);
+    int len = kvprintf(terminal_sink, NULL, fmt, args);
+    va_end(args);
+    return len;
+}
@@ -0,0 +1,30 @@
+#ifndef KERNEL_PRINTF_H
+#define KERNEL_PRINTF_H
+
+#include <stddef.h>
+#include <stdarg.h>
+
+// Formatted output
+// Conversions: %d %i %u %x %X %s %c %p and %%. Flags '-' (left-justify)
+// and '0' (zero-pad), a width given inline or as '*', and a precision for
+// %s only. Integers are 32 bits, or 64 bits with the 'll' length modifier;
+// 'l' and 'z' are accepted and change nothing on i386.
+
+// Receives formatted output in pieces, in order
+typedef void (*kprintf_sink_t)(void *ctx, const char *data, size_t len);
+
+// Format into `sink` in a single pass. Returns the number of characters
+// produced.
+int kvprintf(kprintf_sink_t sink, void *ctx, const char *fmt, va_list args);
+
+// Format into `buf`, writing at most `size` bytes including the terminator.
+// Returns the length the whole output would have had, so a result of
+// `size` or more means it was truncated.
+int ksnprintf(char *buf, size_t size, const char *fmt, ...)
+    __attribute__((format(printf, 3, 4)));
+int kvsnprintf(char *buf, size_t size, const char *fmt, va_list args);
+
+// Format straight to the terminal
+int kprintf(const char *fmt, ...) __attribute__((format(printf, 1, 2)));
+
+#endif // KERNEL_PRINTF_H
@@ -0,0 +1,347 @@
+#ifndef KERNEL_RBTREE_H
+#define KERNEL_RBTREE_H
+
+#include <stddef.h>
+#include <stdbool.h>
+#include "list.h"   // container_of
+
+// Intrusive red-black tree
+// Embed an rb_node_t in each element; the tree orders elements with a
+// comparison callback and never allocates. Lookup, insertion and removal
+// are O(log n) with at most three rotations per update, and rb_next()
+// walks the elements in order. Equal keys are kept, after existing ones.
+// Header only; tools/containers-test.c tests it on the host.
+
+#define RB_RED   0
+#define RB_BLACK 1
+
+typedef struct rb_node {
+    struct rb_node *parent;
+    struct rb_node *left;
+    struct rb_node *right;
+    int color;
+} rb_node_t;
+
+typedef struct rb_tree {
+    rb_node_t *root;
+} rb_tree_t;
+
+// Negative, zero or positive as `a` orders before, with or after `b`
+typedef int (*rb_cmp_t)(const rb_node_t *a, const rb_node_t *b);
+
+// The same against a key that is not in a node
+typedef int (*rb_key_cmp_t)(const void *key, const rb_node_t *node);
+
+#define RB_TREE_INIT { NULL }
+
+static inline void rb_init(rb_tree_t *tree) {
+    tree->root = NULL;
+}
+
+static inline bool rb_empty(const rb_tree_t *tree) {
+    return tree->root == NULL;
+}
+
+static inline bool rb_is_black(const rb_node_t *node) {
+    return !node || node->color == RB_BLACK;
+}
+
+// Point the link from `parent` that held `old` at `node`
+static inline void rb_set_child(rb_tree_t *tree, rb_node_t *parent, rb_node_t *old, rb_node_t *node) {
+    if (!parent) {
+        tree->root = node;
+    } else if (parent->left == old) {
+        parent->left = node;
+    } else {
+        parent->right = node;
+    }
+}
+
+static inline void rb_rotate_left(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *pivot = node->right;
+    node->right = pivot->left;
+    if (pivot->left) {
+        pivot->left->parent = node;
+    }
+    pivot->parent = node->parent;
+    rb_set_child(tree, node->parent, node, pivot);
+    pivot->left = node;
+    node->parent = pivot;
+}
+
+static inline void rb_rotate_right(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *pivot = node->left;
+    node->left = pivot->right;
+    if (pivot->right) {
+        pivot->right->parent = node;
+    }
+    pivot->parent = node->parent;
+    rb_set_child(tree, node->parent, node, pivot);
+    pivot->right = node;
+    node->parent = pivot;
+}
+
+// Restore the red-black rules after linking the red leaf `node`
+static inline void rb_insert_fixup(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *parent;
+    while ((parent = node->parent) && parent->color == RB_RED) {
+        rb_node_t *grand = parent->parent;     // The root is black, so it exists
+        if (parent == grand->left) {
+            rb_node_t *uncle = grand->right;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grand->color = RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->right) {
+                rb_rotate_left(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grand->color = RB_RED;
+            rb_rotate_right(tree, grand);
+        } else {
+            rb_node_t *uncle = grand->left;
+            if (!rb_is_black(uncle)) {
+                parent->color = RB_BLACK;
+                uncle->color = RB_BLACK;
+                grand->color = RB_RED;
+                node = grand;
+                continue;
+            }
+            if (node == parent->left) {
+                rb_rotate_right(tree, parent);
+                node = parent;
+                parent = node->parent;
+            }
+            parent->color = RB_BLACK;
+            grand->color = RB_RED;
+            rb_rotate_left(tree, grand);
+        }
+    }
+    tree->root->color = RB_BLACK;
+}
+
+// Link `node` below `parent` (NULL for an empty tree) on the given side and
+// rebalance. For callers that walk the tree themselves to find the spot.
+static inline void rb_link(rb_tree_t *tree, rb_node_t *node, rb_node_t *parent, bool left) {
+    node->parent = parent;
+    node->left = node->right = NULL;
+    node->color = RB_RED;
+    if (!parent) {
+        tree->root = node;
+    } else if (left) {
+        parent->left = node;
+    } else {
+        parent->right = node;
+    }
+    rb_insert_fixup(tree, node);
+}
+
+static inline void rb_insert(rb_tree_t *tree, rb_node_t *node, rb_cmp_t cmp) {
+    rb_node_t *parent = NULL;
+    rb_node_t *cur = tree->root;
+    bool left = false;
+    while (cur) {
+        parent = cur;
+        left = cmp(node, cur) < 0;
+        cur = left ? cur->left : cur->right;
+    }
+    rb_link(tree, node, parent, left);
+}
+
+// Node equal to `key`, or NULL. With duplicates, any one of them.
+static inline rb_node_t *rb_find(const rb_tree_t *tree, const void *key, rb_key_cmp_t cmp) {
+    rb_node_t *cur = tree->root;
+    while (cur) {
+        int order = cmp(key, cur);
+        if (order == 0) {
+            return cur;
+        }
+        cur = order < 0 ? cur->left : cur->right;
+    }
+    return NULL;
+}
+
+// First node not ordered before `key`, or NULL
+static inline rb_node_t *rb_lower_bound(const rb_tree_t *tree, const void *key, rb_key_cmp_t cmp) {
+    rb_node_t *cur = tree->root;
+    rb_node_t *best = NULL;
+    while (cur) {
+        if (cmp(key, cur) <= 0) {
+            best = cur;
+            cur = cur->left;
+        } else {
+            cur = cur->right;
+        }
+    }
+    return best;
+}
+
+static inline rb_node_t *rb_first(const rb_tree_t *tree) {
+    rb_node_t *node = tree->root;
+    while (node && node->left) {
+        node = node->left;
+    }
+    return node;
+}
+
+static inline rb_node_t *rb_last(const rb_tree_t *tree) {
+    rb_node_t *node = tree->root;
+    while (node && node->right) {
+        node = node->right;
+    }
+    return node;
+}
+
+// In-order successor, or NULL after the last node
+static inline rb_node_t *rb_next(const rb_node_t *node) {
+    if (node->right) {
+        node = node->right;
+        while (node->left) {
+            node = node->left;
+        }
+        return (rb_node_t*)node;
+    }
+    while (node->parent && node == node->parent->right) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+// In-order predecessor, or NULL before the first node
+static inline rb_node_t *rb_prev(const rb_node_t *node) {
+    if (node->left) {
+        node = node->left;
+        while (node->right) {
+            node = node->right;
+        }
+        return (rb_node_t*)node;
+    }
+    while (node->parent && node == node->parent->left) {
+        node = node->parent;
+    }
+    return node->parent;
+}
+
+// Put `node` where `old` was in the tree
+static inline void rb_transplant(rb_tree_t *tree, rb_node_t *old, rb_node_t *node) {
+    rb_set_child(tree, old->parent, old, node);
+    if (node) {
+        node->parent = old->parent;
+    }
+}
+
+// Restore the red-black rules after a black node was removed above `node`
+// (which may be NULL, hence the separate `parent`)
+static inline void rb_remove_fixup(rb_tree_t *tree, rb_node_t *node, rb_node_t *parent) {
+    while (node != tree->root && rb_is_black(node)) {
+        if (node == parent->left) {
+            rb_node_t *sibling = parent->right;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_left(tree, parent);
+                sibling = parent->right;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->right)) {
+                sibling->left->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_right(tree, sibling);
+                sibling = parent->right;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->right->color = RB_BLACK;
+            rb_rotate_left(tree, parent);
+        } else {
+            rb_node_t *sibling = parent->left;
+            if (sibling->color == RB_RED) {
+                sibling->color = RB_BLACK;
+                parent->color = RB_RED;
+                rb_rotate_right(tree, parent);
+                sibling = parent->left;
+            }
+            if (rb_is_black(sibling->left) && rb_is_black(sibling->right)) {
+                sibling->color = RB_RED;
+                node = parent;
+                parent = node->parent;
+                continue;
+            }
+            if (rb_is_black(sibling->left)) {
+                sibling->right->color = RB_BLACK;
+                sibling->color = RB_RED;
+                rb_rotate_left(tree, sibling);
+                sibling = parent->left;
+            }
+            sibling->color = parent->color;
+            parent->color = RB_BLACK;
+            sibling->left->color = RB_BLACK;
+            rb_rotate_right(tree, parent);
+        }
+        node = tree->root;
+        break;
+    }
+    if (node) {
+        node->color = RB_BLACK;
+    }
+}
+
+// Unlink `node`, which must be in `tree`
+static inline void rb_remove(rb_tree_t *tree, rb_node_t *node) {
+    rb_node_t *child;
+    rb_node_t *parent;
+    int color = node->color;
+
+    if (!node->left) {
+        child = node->right;
+        parent = node->parent;
+        rb_transplant(tree, node, child);
+    } else if (!node->right) {
+        child = node->left;
+        parent = node->parent;
+        rb_transplant(tree, node, child);
+    } else {
+        // Replace it with its successor, which has no left child
+        rb_node_t *next = node->right;
+        while (next->left) {
+            next = next->left;
+        }
+        color = next->color;
+        child = next->right;
+        if (next->parent == node) {
+            parent = next;
+        } else {
+            parent = next->parent;
+            rb_transplant(tree, next, child);
+            next->right = node->right;
+            next->right->parent = next;
+        }
+        rb_transplant(tree, node, next);
+        next->left = node->left;
+        next->left->parent = next;
+        next->color = node->color;
+    }
+
+    if (color == RB_BLACK) {
+        rb_remove_fixup(tree, child, parent);
+    }
+}
+
+// Walk the nodes in order. The _safe form allows removing `pos`.
+#define rb_for_each(pos, tree) \
+    for ((pos) = rb_first(tree); (pos); (pos) = rb_next(pos))
+
+#define rb_for_each_safe(pos, tmp, tree) \
+    for ((pos) = rb_first(tree); (pos) && ((tmp) = rb_next(pos), 1); (pos) = (tmp))
+
+#endif // KERNEL_RBTREE_H
@@ -0,0 +1,146 @@
+#ifndef KERNEL_RING_H
+#define KERNEL_RING_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <stdbool.h>
+#include <string.h>
+
+// Single-producer, single-consumer ring buffer
+// For handing data from an interrupt handler to the code that reads it (or
+// back) without disabling interrupts. Only the producer stores `head` and
+// only the consumer stores `tail`; both run freely and wrap at 2^32, so the
+// fill level is head - tail and every slot is usable. The capacity is a
+// power of two and indices are masked rather than divided.
+//
+// Each side loads the other's index with acquire and publishes its own with
+// release ordering. On x86 these are plain moves that the compiler may not
+// reorder or cache, which is all a uniprocessor needs, and the same code is
+// correct between threads on the host (tools/ring-test.c).
+// Header only. The caller owns the storage: `capacity` elements of `esize`
+// bytes each.
+
+typedef struct ring {
+    uint32_t head;          // Elements ever pushed; producer only
+    uint32_t tail;          // Elements ever popped; consumer only
+    uint32_t mask;          // Capacity - 1
+    uint32_t esize;         // Bytes per element
+    uint8_t *data;
+    uint32_t dropped;       // Elements refused because the ring was full
+    uint32_t high_water;    // Most elements held at once
+} ring_t;
+
+#define ring_load_acquire(p)      __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define ring_store_release(p, v)  __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+
+// Initializer for an empty ring over a static array
+#define RING_INIT(data, capacity, esize) \
+    { 0, 0, (capacity) - 1, (esize), (uint8_t*)(data), 0, 0 }
+
+// Empty ring over `data`. Not safe against a running producer or consumer.
+static inline void ring_init(ring_t *ring, void *data, uint32_t capacity, uint32_t esize) {
+    ring->head = 0;
+    ring->tail = 0;
+    ring->mask = capacity - 1;
+    ring->esize = esize;
+    ring->data = (uint8_t*)data;
+    ring->dropped = 0;
+    ring->high_water = 0;
+}
+
+static inline uint32_t ring_capacity(const ring_t *ring) {
+    return ring->mask + 1;
+}
+
+// Elements waiting; exact for the consumer, a lower bound for the producer
+static inline uint32_t ring_count(const ring_t *ring) {
+    return ring_load_acquire(&ring->head) - ring_load_acquire(&ring->tail);
+}
+
+static inline bool ring_empty(const ring_t *ring) {
+    return ring_count(ring) == 0;
+}
+
+// Copy `n` elements in or out starting at index `pos`, in at most two
+// pieces around the end of the storage
+static inline void ring_copy_in(ring_t *ring, uint32_t pos, const uint8_t *src, uint32_t n) {
+    uint32_t first = ring_capacity(ring) - (pos & ring->mask);
+    if (first > n) {
+        first = n;
+    }
+    memcpy(ring->data + (pos & ring->mask) * ring->esize, src, first * ring->esize);
+    memcpy(ring->data, src + first * ring->esize, (n - first) * ring->esize);
+}
+
+static inline void ring_copy_out(const ring_t *ring, uint32_t pos, uint8_t *dest, uint32_t n) {
+    uint32_t first = ring_capacity(ring) - (pos & ring->mask);
+    if (first > n) {
+        first = n;
+    }
+    memcpy(dest, ring->data + (pos & ring->mask) * ring->esize, first * ring->esize);
+    memcpy(dest + first * ring->esize, ring->data, (n - first) * ring->esize);
+}
+
+// Producer: add up to `n` elements, returning how many fit. The rest are
+// counted in `dropped`.
+static inline uint32_t ring_push_bulk(ring_t *ring, const void *elems, uint32_t n) {
+    uint32_t head = ring->head;
+    uint32_t used = head - ring_load_acquire(&ring->tail);
+    uint32_t space = ring_capacity(ring) - used;
+
+    if (n > space) {
+        ring->dropped += n - space;
+        n = space;
+    }
+    if (n) {
+        ring_copy_in(ring, head, (const uint8_t*)elems, n);
+        ring_store_release(&ring->head, head + n);
+        if (used + n > ring->high_water) {
+            ring->high_water = used + n;
+        }
+    }
+    return n;
+}
+
+// Producer: add one element; false (and counted as dropped) when full
+static inline bool ring_push(ring_t *ring, const void *elem) {
+    return ring_push_bulk(ring, elem, 1) == 1;
+}
+
+// Consumer: copy out the element `index` places from the front without
+// removing it; false when there are not that many
+static inline bool ring_peek(const ring_t *ring, uint32_t index, void *elem) {
+    uint32_t tail = ring->tail;
+    if (index >= ring_load_acquire(&ring->head) - tail) {
+        return false;
+    }
+    ring_copy_out(ring, tail + index, (uint8_t*)elem, 1);
+    return true;
+}
+
+// Consumer: remove up to `n` elements into `elems`, returning how many
+static inline uint32_t ring_pop_bulk(ring_t *ring, void *elems, uint32_t n) {
+    uint32_t tail = ring->tail;
+    uint32_t avail = ring_load_acquire(&ring->head) - tail;
+
+    if (n > avail) {
+        n = avail;
+    }
+    if (n) {
+        ring_copy_out(ring, tail, (uint8_t*)elems, n);
+        ring_store_release(&ring->tail, tail + n);
+    }
+    return n;
+}
+
+// Consumer: remove one element; false when empty
+static inline bool ring_pop(ring_t *ring, void *elem) {
+    return ring_pop_bulk(ring, elem, 1) == 1;
+}
+
+// Consumer: throw away everything pushed so far
+static inline void ring_flush(ring_t *ring) {
+    ring_store_release(&ring->tail, ring_load_acquire(&ring->head));
+}
+
+#endif // KERNEL_RING_H
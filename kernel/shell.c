@@ -8,7 +8,15 @@
 #include "timer.h"
 #include "cpu.h"
 #include "memory.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "kstack.h"
+#include "slab.h"
+#include "arena.h"
+#include "shrinker.h"
+#include "heapprof.h"
 #include "util.h"
+#include "printf.h"
 #include "fs.h"
 #include "../fs/include/fs.h"
 #include "../bios/bios.h"
@@ -18,6 +26,8 @@
 fs_node_t *resolve_path(const char *path);
 
 #define MAX_COMMAND_LENGTH 80
+// Size of the first chunk of the per-command arena
+#define COMMAND_ARENA_SIZE 4096
 
 static char command_buffer[MAX_COMMAND_LENGTH];
 static int command_length = 0;
@@ -33,6 +43,12 @@ typedef struct command_t {
 // Head of the command list
 static command_t* command_list = NULL;
 
+// Object cache for command entries
+static kmem_cache_t* command_cache = NULL;
+
+// Temporaries of the running command, reset after each command
+static arena_t* command_arena = NULL;
+
 // Forward declarations of command handlers
 static void cmd_help(int argc, char **argv);
 static void cmd_clear(int argc, char **argv);
@@ -49,6 +65,9 @@ static void cmd_ps(int argc, char **argv);
 static void cmd_bios(int argc, char **argv);
 static void cmd_games(int argc, char **argv);
 static void cmd_hell(int argc, char **argv);
+#ifdef KMALLOC_PROFILE
+static void cmd_heapprof(int argc, char **argv);
+#endif
 
 
 
@@ -96,67 +115,54 @@ static void cmd_info(int argc, char **argv) {
     terminal_puts("\n");
     
     // Memory Info
-    size_t free_mem = get_free_memory() / 1024;
-    size_t used_mem = get_used_memory() / 1024;
-    size_t total_mem = get_total_memory() / 1024;
-    char mem_str[64];
-    char free_val[10], used_val[10], total_val[10];
-    itoa(free_mem, free_val, 10);
-    itoa(used_mem, used_val, 10);
-    itoa(total_mem, total_val, 10);
-    mem_str[0] = '\0';
-    strcat(mem_str, "Memory: ");
-    strcat(mem_str, free_val);
-    strcat(mem_str, " KB free, ");
-    strcat(mem_str, used_val);
-    strcat(mem_str, " KB used, ");
-    strcat(mem_str, total_val);
-    strcat(mem_str, " KB total\n");
-    terminal_puts(mem_str);
+    kprintf("Memory: %u KB free, %u KB used, %u KB total\n",
+            get_free_memory() / 1024, get_used_memory() / 1024,
+            get_total_memory() / 1024);
+
+    // Heap layout
+    kprintf("Heap: %u KB committed, %u KB resident, %u KB reserved\n",
+            get_heap_committed() / 1024, get_heap_resident() / 1024,
+            get_heap_reserved() / 1024);
+    kprintf("Heap free: %u KB, largest %u KB, %u%% fragmented\n",
+            get_heap_free() / 1024, get_largest_free_block() / 1024,
+            get_heap_fragmentation());
+    kprintf("Peak: %u KB used, %u live allocations\n",
+            get_peak_memory() / 1024, get_allocation_count());
+
+    // Memory reclaimed by each shrinker
+    terminal_puts("Reclaimed:");
+    for (shrinker_t *s = shrinker_first(); s; s = s->next) {
+        kprintf("%s%s %u KB in %u runs", s == shrinker_first() ? " " : ", ",
+                s->name, s->reclaimed / 1024, s->runs);
+    }
+    terminal_puts("\n");
+
+    kprintf("Copy-on-write: %u shared frames, %u faults\n",
+            pmm_get_shared_frames(), vmm_get_cow_faults());
+    kprintf("Kernel stacks: %u live, deepest %u bytes used\n",
+            kstack_count(), kstack_max_high_water());
+
+    const initrd_stats_t *initrd = initrd_get_stats();
+    if (initrd->files_checked) {
+        uint32_t bytes = initrd->bytes_checked ? initrd->bytes_checked : 1;
+        kprintf("Initrd checksums: %u files verified, %u bad, %u bytes, %u.%u cycles/byte\n",
+                initrd->files_checked, initrd->files_bad, initrd->bytes_checked,
+                initrd->cycles / bytes, (initrd->cycles % bytes) * 10 / bytes);
+    }
+
+    const ring_t *keys = keyboard_get_ring();
+    kprintf("Keyboard buffer: %u/%u peak, %u keys dropped\n",
+            keys->high_water, ring_capacity(keys), keys->dropped);
     
     // Uptime
     uint32_t uptime = timer_get_uptime_seconds();
-    uint32_t hours = uptime / 3600;
-    uint32_t minutes = (uptime % 3600) / 60;
-    uint32_t seconds = uptime % 60;
-    char uptime_str[32];
-    char hour_str[10], min_str[10], sec_str[10];
-    itoa(hours, hour_str, 10);
-    itoa(minutes, min_str, 10);
-    itoa(seconds, sec_str, 10);
-    uptime_str[0] = '\0';
-    strcat(uptime_str, "Uptime: ");
-    if (hours < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, hour_str);
-    strcat(uptime_str, ":");
-    if (minutes < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, min_str);
-    strcat(uptime_str, ":");
-    if (seconds < 10) strcat(uptime_str, "0");
-    strcat(uptime_str, sec_str);
-    strcat(uptime_str, "\n");
-    terminal_puts(uptime_str);
+    kprintf("Uptime: %02u:%02u:%02u\n",
+            uptime / 3600, (uptime % 3600) / 60, uptime % 60);
     
     // Time
     rtc_time_t time;
     rtc_get_time(&time);
-    char time_str[16];
-    char rtc_hour_str[3], rtc_min_str[3], rtc_sec_str[3];
-    itoa(time.hour, rtc_hour_str, 10);
-    itoa(time.minute, rtc_min_str, 10);
-    itoa(time.second, rtc_sec_str, 10);
-    time_str[0] = '\0';
-    if (time.hour < 10) strcat(time_str, "0");
-    strcat(time_str, rtc_hour_str);
-    strcat(time_str, ":");
-    if (time.minute < 10) strcat(time_str, "0");
-    strcat(time_str, rtc_min_str);
-    strcat(time_str, ":");
-    if (time.second < 10) strcat(time_str, "0");
-    strcat(time_str, rtc_sec_str);
-    strcat(time_str, "\n");
-    terminal_puts("Current Time: ");
-    terminal_puts(time_str);
+    kprintf("Current Time: %02u:%02u:%02u\n", time.hour, time.minute, time.second);
     
     terminal_puts("\n");
 }
@@ -206,25 +212,7 @@ static void cmd_date(int argc, char **argv) {
     rtc_time_t time;
     rtc_get_time(&time);
     
-    char time_str[16];
-    char hour_str[3], min_str[3], sec_str[3];
-    itoa(time.hour, hour_str, 10);
-    itoa(time.minute, min_str, 10);
-    itoa(time.second, sec_str, 10);
-    
-    time_str[0] = '\0';
-    if (time.hour < 10) strcat(time_str, "0");
-    strcat(time_str, hour_str);
-    strcat(time_str, ":");
-    if (time.minute < 10) strcat(time_str, "0");
-    strcat(time_str, min_str);
-    strcat(time_str, ":");
-    if (time.second < 10) strcat(time_str, "0");
-    strcat(time_str, sec_str);
-    
-    terminal_puts("\n");
-    terminal_puts(time_str);
-    terminal_puts("\n");
+    kprintf("\n%02u:%02u:%02u\n", time.hour, time.minute, time.second);
 }
 
 static void cmd_cat(int argc, char **argv) {
@@ -419,9 +407,41 @@ static void cmd_hell(int argc, char **argv) {
     vga_manager_set_color(VGA_COLOR_WHITE, VGA_COLOR_BLACK);
 }
 
+#ifdef KMALLOC_PROFILE
+static void cmd_heapprof(int argc, char **argv) {
+    terminal_puts("\n");
+
+    if (argc < 2) {
+        heapprof_report();
+        return;
+    }
+
+    if (strcmp(argv[1], "leaks") != 0) {
+        terminal_puts("Usage: heapprof [leaks <seconds>]\n");
+        return;
+    }
+
+    uint32_t seconds = 60;
+    if (argc > 2) {
+        seconds = 0;
+        const char *p = argv[2];
+        while (*p >= '0' && *p <= '9') {
+            seconds = seconds * 10 + (*p - '0');
+            p++;
+        }
+    }
+    heapprof_report_leaks(seconds);
+}
+#endif
+
 // Register a new command
 void shell_register_command(const char* name, const char* description, command_handler_t handler) {
-    command_t* new_cmd = (command_t*)kmalloc(sizeof(command_t));
+    if (!command_cache) {
+        command_cache = kmem_cache_create("command", sizeof(command_t), SLAB_HWCACHE_ALIGN, NULL);
+        if (!command_cache) return;
+    }
+
+    command_t* new_cmd = (command_t*)kmem_cache_alloc(command_cache);
     if (!new_cmd) return;
     
     new_cmd->name = name;
@@ -462,6 +482,7 @@ void shell_init(void) {
     command_length = 0;
     command_buffer[0] = '\0';
     command_list = NULL;
+    command_arena = arena_create(COMMAND_ARENA_SIZE);
     
     // Register built-in commands
     shell_register_command("help", "Show this help message", cmd_help);
@@ -479,6 +500,14 @@ void shell_init(void) {
     shell_register_command("bios", "Enter the BIOS", cmd_bios);
     shell_register_command("games", "Play games", cmd_games);
     shell_register_command("hell", "Display hell ASCII art", cmd_hell);
+#ifdef KMALLOC_PROFILE
+    shell_register_command("heapprof", "Show kmalloc call sites and leaks", cmd_heapprof);
+#endif
+}
+
+// Scratch memory for the running command
+void *shell_alloc(size_t size) {
+    return arena_alloc(command_arena, size);
 }
 
 void shell_print_prompt(void) {
@@ -508,6 +537,7 @@ void shell_process_command(const char* command) {
     while (cmd) {
         if (strcmp(argv[0], cmd->name) == 0) {
             cmd->handler(argc, argv);
+            arena_reset(command_arena);
             return;
         }
         cmd = cmd->next;
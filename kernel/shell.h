@@ -1,6 +1,8 @@
 #ifndef KERNEL_SHELL_H
 #define KERNEL_SHELL_H
 
+#include <stddef.h>
+
 // Command handler type with arguments support
 typedef void (*command_handler_t)(int argc, char **argv);
 
@@ -19,4 +21,7 @@ void shell_register_command(const char* name, const char* description, command_h
 // Parse command line into arguments
 int shell_parse_arguments(char *line, char **argv, int max_args);
 
+// Scratch memory for the running command, released when it returns
+void *shell_alloc(size_t size);
+
 #endif // KERNEL_SHELL_H
@@ -0,0 +1,55 @@
+#include "shrinker.h"
+#include "kernel.h"
+#include "util.h"
+#include "pmm.h"
+
+// Shrinker registry
+// Shrinkers walk caches that are only changed from task context, so reclaim
+// never runs with interrupts disabled; callers there just see the failure.
+
+static shrinker_t *shrinkers = NULL;
+static bool reclaiming = false;
+
+// Add a shrinker, keeping the list sorted by cost
+void shrinker_register(shrinker_t *shrinker) {
+    shrinker->reclaimed = 0;
+    shrinker->runs = 0;
+
+    shrinker_t **link = &shrinkers;
+    while (*link && (*link)->cost <= shrinker->cost) {
+        link = &(*link)->next;
+    }
+    shrinker->next = *link;
+    *link = shrinker;
+}
+
+// Run shrinkers until `target` bytes are freed
+size_t shrink_memory(size_t target) {
+    if (reclaiming || !irq_enabled()) return 0;
+    reclaiming = true;
+
+    size_t freed = 0;
+    for (shrinker_t *s = shrinkers; s && freed < target; s = s->next) {
+        size_t bytes = s->shrink(target - freed);
+        if (bytes) {
+            s->reclaimed += bytes;
+            s->runs++;
+            freed += bytes;
+        }
+    }
+
+    reclaiming = false;
+    return freed;
+}
+
+// Reclaim when free frames run low
+void shrink_check_watermark(void) {
+    uint32_t free = pmm_get_free_frames();
+    if (free < SHRINK_LOW_WATERMARK) {
+        shrink_memory((size_t)(SHRINK_HIGH_WATERMARK - free) * PAGE_SIZE);
+    }
+}
+
+shrinker_t *shrinker_first(void) {
+    return shrinkers;
+}
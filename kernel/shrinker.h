@@ -0,0 +1,42 @@
+#ifndef KERNEL_SHRINKER_H
+#define KERNEL_SHRINKER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Memory reclaim from kernel caches
+// Subsystems that hold memory they can rebuild register a shrinker. When an
+// allocation fails, or free frames drop below SHRINK_LOW_WATERMARK, the
+// allocator runs the shrinkers cheapest first and retries.
+
+// Free frames below which reclaim starts, and the level it aims for
+#define SHRINK_LOW_WATERMARK  64
+#define SHRINK_HIGH_WATERMARK 128
+
+// Release about `target` bytes; returns the bytes actually freed
+typedef size_t (*shrink_fn_t)(size_t target);
+
+typedef struct shrinker {
+    const char *name;
+    shrink_fn_t shrink;
+    uint32_t cost;          // Relative cost of rebuilding; lower runs first
+    size_t reclaimed;       // Bytes freed since boot
+    uint32_t runs;          // Calls that freed anything
+    struct shrinker *next;
+} shrinker_t;
+
+// Add a shrinker; the structure must stay valid for the life of the kernel
+void shrinker_register(shrinker_t *shrinker);
+
+// Run shrinkers in cost order until `target` bytes are freed. Returns the
+// bytes freed. Does nothing with interrupts disabled or while reclaim is
+// already running.
+size_t shrink_memory(size_t target);
+
+// Reclaim up to the high watermark when free frames are below the low one
+void shrink_check_watermark(void);
+
+// Registered shrinkers, cheapest first
+shrinker_t *shrinker_first(void);
+
+#endif // KERNEL_SHRINKER_H
@@ -0,0 +1,235 @@
+#include "slab.h"
+#include "kernel.h"
+#include "memory.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "shrinker.h"
+
+// Slab allocator
+// A slab is a buddy block of 2^order pages holding its header followed by
+// equally sized objects. Buddy blocks are aligned to their size, so the slab
+// owning an object is found by masking the object address.
+
+typedef struct slab {
+    struct slab *next;
+    struct slab *prev;
+    kmem_cache_t *cache;
+    void *free;             // Free objects in this slab
+    uint32_t inuse;         // Objects handed out
+} slab_t;
+
+struct kmem_cache {
+    const char *name;
+    size_t size;            // Object stride
+    size_t free_offset;     // Where the free-list link lives in an object
+    size_t first;           // Offset of the first object in a slab
+    uint32_t order;         // Slab size is 2^order pages
+    uint32_t objs_per_slab;
+    kmem_ctor_t ctor;
+
+    // Slabs by fill level
+    slab_t *partial;
+    slab_t *full;
+    slab_t *empty;
+    uint32_t num_empty;
+
+    struct kmem_cache *next;    // Every cache, for the shrinker
+};
+
+// Slab order never exceeds this; objects must fit at least once
+#define SLAB_MAX_ORDER  3
+// Target number of objects per slab when picking the order
+#define SLAB_MIN_OBJS   8
+// Empty slabs a cache keeps before giving pages back
+#define SLAB_KEEP_EMPTY 1
+
+static kmem_cache_t *caches = NULL;
+
+static void slab_list_add(slab_t **head, slab_t *slab) {
+    slab->prev = NULL;
+    slab->next = *head;
+    if (*head) {
+        (*head)->prev = slab;
+    }
+    *head = slab;
+}
+
+static void slab_list_remove(slab_t **head, slab_t *slab) {
+    if (slab->prev) {
+        slab->prev->next = slab->next;
+    } else {
+        *head = slab->next;
+    }
+    if (slab->next) {
+        slab->next->prev = slab->prev;
+    }
+}
+
+static inline void **obj_link(kmem_cache_t *cache, void *obj) {
+    return (void**)((char*)obj + cache->free_offset);
+}
+
+// Create a cache of `size`-byte objects
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, uint32_t flags, kmem_ctor_t ctor) {
+    kmem_cache_t *cache = (kmem_cache_t*)kmalloc(sizeof(kmem_cache_t));
+    if (!cache) return NULL;
+
+    // Objects with a constructor keep their state while free, so the
+    // free-list link goes after the object instead of over it
+    size_t align = sizeof(void*);
+    size = (size + align - 1) & ~(align - 1);
+    cache->free_offset = ctor ? size : 0;
+    if (ctor || size < sizeof(void*)) {
+        size += sizeof(void*);
+    }
+
+    // Cache-line alignment; small objects share a line without straddling it
+    if (flags & SLAB_HWCACHE_ALIGN) {
+        align = CACHE_LINE_SIZE;
+        while (align > sizeof(void*) && size <= align / 2) {
+            align /= 2;
+        }
+    }
+    size = (size + align - 1) & ~(align - 1);
+
+    cache->name = name;
+    cache->size = size;
+    cache->first = (sizeof(slab_t) + align - 1) & ~(align - 1);
+    cache->ctor = ctor;
+    cache->partial = NULL;
+    cache->full = NULL;
+    cache->empty = NULL;
+    cache->num_empty = 0;
+
+    // Smallest slab holding SLAB_MIN_OBJS objects, within SLAB_MAX_ORDER
+    cache->order = 0;
+    while (cache->order < SLAB_MAX_ORDER &&
+           (((size_t)PAGE_SIZE << cache->order) - cache->first) / size < SLAB_MIN_OBJS) {
+        cache->order++;
+    }
+    cache->objs_per_slab = (((size_t)PAGE_SIZE << cache->order) - cache->first) / size;
+    if (cache->objs_per_slab == 0) {
+        kfree(cache);
+        return NULL;
+    }
+
+    cache->next = caches;
+    caches = cache;
+    return cache;
+}
+
+// Build a new slab with every object constructed and free
+static slab_t *slab_create(kmem_cache_t *cache) {
+    uint32_t addr = pmm_alloc_pages(cache->order);
+    if (!addr && shrink_memory((size_t)PAGE_SIZE << cache->order)) {
+        addr = pmm_alloc_pages(cache->order);
+    }
+    if (!addr) return NULL;
+
+    slab_t *slab = (slab_t*)PHYS_TO_VIRT(addr);
+    slab->cache = cache;
+    slab->inuse = 0;
+    slab->free = NULL;
+
+    // Thread the free list so objects are handed out in address order
+    char *obj = (char*)slab + cache->first + (cache->objs_per_slab - 1) * cache->size;
+    for (uint32_t i = 0; i < cache->objs_per_slab; i++) {
+        if (cache->ctor) {
+            cache->ctor(obj);
+        }
+        *obj_link(cache, obj) = slab->free;
+        slab->free = obj;
+        obj -= cache->size;
+    }
+
+    return slab;
+}
+
+// Allocate an object from the cache
+void *kmem_cache_alloc(kmem_cache_t *cache) {
+    if (!cache) return NULL;
+
+    slab_t *slab = cache->partial;
+    if (!slab) {
+        slab = cache->empty;
+        if (slab) {
+            slab_list_remove(&cache->empty, slab);
+            cache->num_empty--;
+        } else {
+            slab = slab_create(cache);
+            if (!slab) return NULL;
+        }
+        slab_list_add(&cache->partial, slab);
+    }
+
+    void *obj = slab->free;
+    slab->free = *obj_link(cache, obj);
+    slab->inuse++;
+
+    if (slab->inuse == cache->objs_per_slab) {
+        slab_list_remove(&cache->partial, slab);
+        slab_list_add(&cache->full, slab);
+    }
+
+    return obj;
+}
+
+// Return an object to its cache
+void kmem_cache_free(kmem_cache_t *cache, void *obj) {
+    if (!cache || !obj) return;
+
+    size_t slab_bytes = (size_t)PAGE_SIZE << cache->order;
+    slab_t *slab = (slab_t*)((uint32_t)obj & ~(slab_bytes - 1));
+    if (slab->cache != cache) {
+        panic("kmem_cache_free: object freed to the wrong cache");
+    }
+
+    if (slab->inuse == cache->objs_per_slab) {
+        slab_list_remove(&cache->full, slab);
+        slab_list_add(&cache->partial, slab);
+    }
+
+    *obj_link(cache, obj) = slab->free;
+    slab->free = obj;
+    slab->inuse--;
+
+    if (slab->inuse == 0) {
+        slab_list_remove(&cache->partial, slab);
+        if (cache->num_empty < SLAB_KEEP_EMPTY) {
+            slab_list_add(&cache->empty, slab);
+            cache->num_empty++;
+        } else {
+            pmm_free_pages(VIRT_TO_PHYS(slab));
+        }
+    }
+}
+
+// Give the cache's empty slabs back
+size_t kmem_cache_shrink(kmem_cache_t *cache) {
+    if (!cache) return 0;
+
+    size_t freed = 0;
+    while (cache->empty) {
+        slab_t *slab = cache->empty;
+        slab_list_remove(&cache->empty, slab);
+        cache->num_empty--;
+        pmm_free_pages(VIRT_TO_PHYS(slab));
+        freed += (size_t)PAGE_SIZE << cache->order;
+    }
+    return freed;
+}
+
+// Empty slabs only cost a constructor run per object to rebuild
+static size_t slab_shrink(size_t target) {
+    size_t freed = 0;
+    for (kmem_cache_t *cache = caches; cache && freed < target; cache = cache->next) {
+        freed += kmem_cache_shrink(cache);
+    }
+    return freed;
+}
+
+static shrinker_t slab_shrinker = { "slab", slab_shrink, 1, 0, 0, NULL };
+
+void slab_init(void) {
+    shrinker_register(&slab_shrinker);
+}
@@ -0,0 +1,37 @@
+#ifndef KERNEL_SLAB_H
+#define KERNEL_SLAB_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Object caches for fixed-size kernel objects
+// Each cache packs objects of one size into slabs of whole pages and keeps
+// them on per-cache free lists, so allocation and free are O(1).
+
+#define CACHE_LINE_SIZE 64
+
+// Cache flags
+#define SLAB_HWCACHE_ALIGN 0x01   // Align objects to cache lines
+
+typedef struct kmem_cache kmem_cache_t;
+
+// Object constructor, run once per object when its slab is created.
+// Objects must be returned to the cache in their constructed state.
+typedef void (*kmem_ctor_t)(void *obj);
+
+// Register the slab caches with the shrinkers
+void slab_init(void);
+
+// Create a cache of `size`-byte objects
+kmem_cache_t *kmem_cache_create(const char *name, size_t size, uint32_t flags, kmem_ctor_t ctor);
+
+// Allocate an object from the cache, or NULL when out of memory
+void *kmem_cache_alloc(kmem_cache_t *cache);
+
+// Return an object to its cache
+void kmem_cache_free(kmem_cache_t *cache, void *obj);
+
+// Give the cache's empty slabs back; returns the bytes freed
+size_t kmem_cache_shrink(kmem_cache_t *cache);
+
+#endif // KERNEL_SLAB_H
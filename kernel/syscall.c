@@ -3,6 +3,8 @@
 #include "vga_manager.h"
 #include "terminal.h"
 #include "memory.h"
+#include "vmm.h"
+#include "vma.h"
 #include "timer.h"
 #include "fs.h"
 #include "../fs/include/fs.h"
@@ -15,6 +17,12 @@ extern void syscall_handler_asm(void);
 // Current process ID (simple implementation)
 static int current_pid = 1;
 
+// Address space of each process, indexed by pid - 1; NULL marks a free
+// slot. The shell (pid 1) runs in the kernel page directory.
+#define MAX_PROCESSES 16
+static mm_t *process_mm[MAX_PROCESSES] = { NULL };
+static int process_parent[MAX_PROCESSES] = { 0 };
+
 // System call handler (called from assembly)
 // Arguments are passed via registers: eax=syscall_num, ebx=arg1, ecx=arg2, edx=arg3
 void syscall_handler(void) {
@@ -48,6 +56,13 @@ void syscall_handler(void) {
 void syscall_init(void) {
     // Set up interrupt 0x80 for system calls
     idt_set_gate(0x80, (uint32_t)syscall_handler_asm, KERNEL_CS, IDT_FLAG_32BIT_INTERRUPT | IDT_FLAG_RING3 | IDT_FLAG_PRESENT);
+
+    vma_init();
+    process_mm[0] = mm_create(vmm_get_directory());
+    if (!process_mm[0]) {
+        panic("syscall_init: cannot create the shell address space");
+    }
+    mm_switch(process_mm[0]);
 }
 
 // System call dispatcher
@@ -69,6 +84,9 @@ uint32_t syscall_dispatcher(uint32_t syscall_num, uint32_t arg1, uint32_t arg2,
         case SYS_CLOSE:
             return sys_close((int)arg1);
             
+        case SYS_FORK:
+            return sys_fork();
+            
         case SYS_GETPID:
             return sys_getpid();
             
@@ -82,16 +100,39 @@ uint32_t syscall_dispatcher(uint32_t syscall_num, uint32_t arg1, uint32_t arg2,
             sys_free((void*)arg1);
             return 0;
             
+        case SYS_MMAP:
+            return sys_mmap(arg1, arg2, arg3);
+            
+        case SYS_MUNMAP:
+            return sys_munmap(arg1, arg2);
+            
+        case SYS_KILL:
+            return sys_kill((int)arg1);
+            
         default:
             return (uint32_t)-1;  // Invalid system call
     }
 }
 
+// Free the address space of a forked process and its slot. Its frames go
+// back to the allocator, and parent pages it shared become writable again
+// on their next write fault.
+static void process_release(int slot) {
+    mm_destroy(process_mm[slot]);
+    process_mm[slot] = NULL;
+    process_parent[slot] = 0;
+}
+
 // System call implementations
 void sys_exit(int status) {
     (void)status;  // For now, just ignore status
-    // In a real OS, this would clean up the process
-    // For now, we'll just halt
+    // Nothing can ever run the children of the caller, so release them.
+    // The caller keeps running; there is no scheduler to switch away.
+    for (int slot = 1; slot < MAX_PROCESSES; slot++) {
+        if (process_mm[slot] && process_parent[slot] == current_pid) {
+            process_release(slot);
+        }
+    }
     terminal_puts("\nProcess exited\n");
 }
 
@@ -130,6 +171,34 @@ int sys_close(int fd) {
     return 0;
 }
 
+// Clone the address space of the calling process copy-on-write. There is
+// no scheduler yet, so the child's address space is only set up and kept
+// under its pid until sys_kill() or the parent's sys_exit() releases it;
+// the parent gets the pid back.
+int sys_fork(void) {
+    int slot = 1;
+    while (slot < MAX_PROCESSES && process_mm[slot]) {
+        slot++;
+    }
+    if (slot == MAX_PROCESSES) return -1;
+
+    mm_t *child = mm_clone(process_mm[current_pid - 1]);
+    if (!child) return -1;
+
+    process_mm[slot] = child;
+    process_parent[slot] = current_pid;
+    return slot + 1;
+}
+
+// End a forked process that is not running and release its address space
+int sys_kill(int pid) {
+    if (pid < 2 || pid > MAX_PROCESSES || pid == current_pid) return -1;
+    if (!process_mm[pid - 1]) return -1;
+
+    process_release(pid - 1);
+    return 0;
+}
+
 int sys_getpid(void) {
     return current_pid;
 }
@@ -151,3 +220,20 @@ void sys_free(void *ptr) {
     kfree(ptr);
 }
 
+// Reserve anonymous memory in the caller's address space. Pages are backed
+// by the page fault handler on first touch.
+uint32_t sys_mmap(uint32_t addr, uint32_t length, uint32_t flags) {
+    if (!(flags & MAP_ANONYMOUS)) return MAP_FAILED;
+
+    uint32_t vma_flags = 0;
+    if (flags & PROT_READ) vma_flags |= VMA_READ;
+    if (flags & PROT_WRITE) vma_flags |= VMA_READ | VMA_WRITE;
+
+    uint32_t start = mm_map(process_mm[current_pid - 1], addr, length, vma_flags);
+    return start ? start : MAP_FAILED;
+}
+
+int sys_munmap(uint32_t addr, uint32_t length) {
+    return mm_unmap(process_mm[current_pid - 1], addr, length) ? 0 : -1;
+}
+
@@ -15,6 +15,15 @@
 #define SYS_SLEEP       9
 #define SYS_MALLOC      10
 #define SYS_FREE        11
+#define SYS_MMAP        12
+#define SYS_MUNMAP      13
+#define SYS_KILL        14
+
+// SYS_MMAP flags; only anonymous mappings are supported
+#define PROT_READ       0x1
+#define PROT_WRITE      0x2
+#define MAP_ANONYMOUS   0x20
+#define MAP_FAILED      ((uint32_t)-1)
 
 // System call handler
 void syscall_handler(void);
@@ -37,6 +46,9 @@ int sys_getpid(void);
 int sys_sleep(uint32_t seconds);
 void* sys_malloc(uint32_t size);
 void sys_free(void *ptr);
+uint32_t sys_mmap(uint32_t addr, uint32_t length, uint32_t flags);
+int sys_munmap(uint32_t addr, uint32_t length);
+int sys_kill(int pid);
 
 #endif // KERNEL_SYSCALL_H
 
@@ -19,7 +19,7 @@ void timer_handler(void) {
     pic_send_eoi(0);
     
     // Update GUI every ~18 ticks (approximately once per second)
-    if (uptime_ticks % 18 == 0) {
+    if (uptime_ticks % TIMER_HZ == 0) {
         gui_draw_time();
         gui_draw_memory();
         gui_draw_uptime();
@@ -28,7 +28,12 @@ void timer_handler(void) {
 
 // Get uptime in seconds
 uint32_t timer_get_uptime_seconds(void) {
-    return uptime_ticks / 18;  // Approximately 18.2 ticks per second
+    return uptime_ticks / TIMER_HZ;  // Approximately 18.2 ticks per second
+}
+
+// Get uptime in timer ticks
+uint32_t timer_get_ticks(void) {
+    return uptime_ticks;
 }
 
 // Initialize the timer
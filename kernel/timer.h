@@ -3,7 +3,11 @@
 
 #include <stdint.h>
 
+// PIT rate with the reload value of 0 (1193182 / 65536 Hz)
+#define TIMER_HZ 18
+
 void timer_init(void);
 uint32_t timer_get_uptime_seconds(void);
+uint32_t timer_get_ticks(void);
 
 #endif // KERNEL_TIMER_H
@@ -2,6 +2,9 @@
 #define KERNEL_UTIL_H
 
 #include <stdint.h>
+#include <stdbool.h>
+
+#define EFLAGS_IF 0x200
 
 void outb(uint16_t port, uint8_t val);
 uint8_t inb(uint16_t port);
@@ -16,6 +19,30 @@ static inline uint16_t inw(uint16_t port) {
     return ret;
 }
 
+// Disable interrupts, returning the previous EFLAGS for irq_restore()
+static inline uint32_t irq_save(void) {
+    uint32_t flags;
+    asm volatile ("pushfl\n\tpopl %0\n\tcli" : "=r"(flags) : : "memory");
+    return flags;
+}
+
+// Restore the interrupt flag saved by irq_save()
+static inline void irq_restore(uint32_t flags) {
+    asm volatile ("pushl %0\n\tpopfl" : : "r"(flags) : "memory", "cc");
+}
 
+// True when interrupts are enabled
+static inline bool irq_enabled(void) {
+    uint32_t flags;
+    asm volatile ("pushfl\n\tpopl %0" : "=r"(flags));
+    return flags & EFLAGS_IF;
+}
+
+// Time stamp counter; only when cpu_get_info()->has_tsc
+static inline uint64_t rdtsc(void) {
+    uint32_t lo, hi;
+    asm volatile ("rdtsc" : "=a"(lo), "=d"(hi));
+    return ((uint64_t)hi << 32) | lo;
+}
 
 #endif // KERNEL_UTIL_H
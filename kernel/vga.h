@@ -4,6 +4,7 @@
 #include <stdint.h>
 #include <stddef.h>
 #include <stdbool.h>
+#include "vmm.h"
 
 /* Hardware text mode color constants. */
 enum vga_color {
@@ -26,7 +27,7 @@ enum vga_color {
 };
 
 // VGA text mode buffer address
-#define VGA_MEMORY (uint16_t*)0xB8000
+#define VGA_MEMORY ((uint16_t*)PHYS_TO_VIRT(0xB8000))
 #define VGA_WIDTH 80
 #define VGA_HEIGHT 25
 
@@ -0,0 +1,325 @@
+#include "vma.h"
+#include "kernel.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "slab.h"
+#include "zeropool.h"
+
+// Virtual memory areas
+// The tree is an AVL tree. Trimming an area in place never changes its
+// order relative to its neighbours, so only whole areas are inserted or
+// removed.
+
+static kmem_cache_t *vma_cache = NULL;
+static kmem_cache_t *mm_cache = NULL;
+static mm_t *current_mm = NULL;
+
+static inline int32_t vma_height(vma_t *node) {
+    return node ? node->height : 0;
+}
+
+static void vma_update(vma_t *node) {
+    int32_t left = vma_height(node->left);
+    int32_t right = vma_height(node->right);
+    node->height = 1 + (left > right ? left : right);
+}
+
+static vma_t *rotate_right(vma_t *node) {
+    vma_t *pivot = node->left;
+    node->left = pivot->right;
+    pivot->right = node;
+    vma_update(node);
+    vma_update(pivot);
+    return pivot;
+}
+
+static vma_t *rotate_left(vma_t *node) {
+    vma_t *pivot = node->right;
+    node->right = pivot->left;
+    pivot->left = node;
+    vma_update(node);
+    vma_update(pivot);
+    return pivot;
+}
+
+// Restore the AVL invariant at `node` after one of its subtrees changed
+static vma_t *vma_balance(vma_t *node) {
+    vma_update(node);
+    int32_t balance = vma_height(node->left) - vma_height(node->right);
+
+    if (balance > 1) {
+        if (vma_height(node->left->left) < vma_height(node->left->right)) {
+            node->left = rotate_left(node->left);
+        }
+        return rotate_right(node);
+    }
+    if (balance < -1) {
+        if (vma_height(node->right->right) < vma_height(node->right->left)) {
+            node->right = rotate_right(node->right);
+        }
+        return rotate_left(node);
+    }
+    return node;
+}
+
+static vma_t *vma_insert(vma_t *node, vma_t *vma) {
+    if (!node) {
+        vma->left = vma->right = NULL;
+        vma->height = 1;
+        return vma;
+    }
+
+    if (vma->start < node->start) {
+        node->left = vma_insert(node->left, vma);
+    } else {
+        node->right = vma_insert(node->right, vma);
+    }
+    return vma_balance(node);
+}
+
+// Detach the leftmost node of a subtree into `*min`
+static vma_t *vma_remove_min(vma_t *node, vma_t **min) {
+    if (!node->left) {
+        *min = node;
+        return node->right;
+    }
+    node->left = vma_remove_min(node->left, min);
+    return vma_balance(node);
+}
+
+static vma_t *vma_remove(vma_t *node, vma_t *vma) {
+    if (!node) return NULL;
+
+    if (vma->start < node->start) {
+        node->left = vma_remove(node->left, vma);
+    } else if (vma->start > node->start) {
+        node->right = vma_remove(node->right, vma);
+    } else {
+        if (!node->left) return node->right;
+        if (!node->right) return node->left;
+
+        vma_t *successor;
+        vma_t *right = vma_remove_min(node->right, &successor);
+        successor->left = node->left;
+        successor->right = right;
+        node = successor;
+    }
+    return vma_balance(node);
+}
+
+// Some area overlapping [start, end), or NULL
+static vma_t *vma_overlap(mm_t *mm, uint32_t start, uint32_t end) {
+    vma_t *node = mm->root;
+    while (node) {
+        if (node->end <= start) {
+            node = node->right;
+        } else if (node->start >= end) {
+            node = node->left;
+        } else {
+            return node;
+        }
+    }
+    return NULL;
+}
+
+vma_t *vma_find(mm_t *mm, uint32_t addr) {
+    return vma_overlap(mm, addr, addr + 1);
+}
+
+// Walk the areas in address order looking for a gap of `length` bytes
+// starting at or above `*cursor`
+static bool find_gap(vma_t *node, uint32_t *cursor, uint32_t length) {
+    if (!node) return false;
+
+    if (find_gap(node->left, cursor, length)) return true;
+    if (node->start >= *cursor && node->start - *cursor >= length) return true;
+    if (node->end > *cursor) {
+        *cursor = node->end;
+    }
+    return find_gap(node->right, cursor, length);
+}
+
+static vma_t *vma_new(uint32_t start, uint32_t end, uint32_t flags) {
+    vma_t *vma = (vma_t*)kmem_cache_alloc(vma_cache);
+    if (vma) {
+        vma->start = start;
+        vma->end = end;
+        vma->flags = flags;
+    }
+    return vma;
+}
+
+// Free the frames backing [start, end)
+static void release_range(mm_t *mm, uint32_t start, uint32_t end) {
+    for (uint32_t page = start; page < end; page += PAGE_SIZE) {
+        uint32_t frame = vmm_unmap_user(mm->directory, page);
+        if (frame) {
+            pmm_frame_release(frame);
+        }
+    }
+}
+
+void vma_init(void) {
+    vma_cache = kmem_cache_create("vma", sizeof(vma_t), 0, NULL);
+    mm_cache = kmem_cache_create("mm", sizeof(mm_t), 0, NULL);
+    if (!vma_cache || !mm_cache) {
+        panic("vma_init: cannot create caches");
+    }
+}
+
+mm_t *mm_create(uint32_t directory) {
+    mm_t *mm = (mm_t*)kmem_cache_alloc(mm_cache);
+    if (!mm) return NULL;
+
+    mm->directory = directory;
+    mm->root = NULL;
+    mm->num_areas = 0;
+    mm->reserved = 0;
+    return mm;
+}
+
+static void vma_free_tree(vma_t *node) {
+    if (!node) return;
+    vma_free_tree(node->left);
+    vma_free_tree(node->right);
+    kmem_cache_free(vma_cache, node);
+}
+
+// Copy a subtree node for node, so the copy is balanced too
+static vma_t *vma_copy_tree(vma_t *node, bool *failed) {
+    if (!node || *failed) return NULL;
+
+    vma_t *copy = vma_new(node->start, node->end, node->flags);
+    if (!copy) {
+        *failed = true;
+        return NULL;
+    }
+    copy->height = node->height;
+    copy->left = vma_copy_tree(node->left, failed);
+    copy->right = vma_copy_tree(node->right, failed);
+    return copy;
+}
+
+mm_t *mm_clone(mm_t *mm) {
+    uint32_t directory = vmm_clone_directory(mm->directory);
+    if (!directory) return NULL;
+
+    mm_t *clone = mm_create(directory);
+    bool failed = !clone;
+    if (clone) {
+        clone->root = vma_copy_tree(mm->root, &failed);
+        clone->num_areas = mm->num_areas;
+        clone->reserved = mm->reserved;
+    }
+    if (failed) {
+        if (clone) {
+            mm_destroy(clone);
+        } else {
+            vmm_free_directory(directory);
+        }
+        return NULL;
+    }
+    return clone;
+}
+
+void mm_destroy(mm_t *mm) {
+    vma_free_tree(mm->root);
+    vmm_free_directory(mm->directory);
+    kmem_cache_free(mm_cache, mm);
+}
+
+void mm_switch(mm_t *mm) {
+    current_mm = mm;
+    vmm_switch_directory(mm->directory);
+}
+
+mm_t *mm_current(void) {
+    return current_mm;
+}
+
+// Reserve anonymous memory
+uint32_t mm_map(mm_t *mm, uint32_t addr, uint32_t length, uint32_t flags) {
+    if (length == 0 || length > MMAP_END - MMAP_BASE) return 0;
+    length = (length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1);
+
+    // Use the hint when the whole range is free
+    bool fits = addr >= MMAP_BASE && !(addr & (PAGE_SIZE - 1)) &&
+                addr <= MMAP_END - length && !vma_overlap(mm, addr, addr + length);
+    if (!fits) {
+        addr = MMAP_BASE;
+        if (!find_gap(mm->root, &addr, length) && MMAP_END - addr < length) {
+            return 0;
+        }
+    }
+
+    vma_t *vma = vma_new(addr, addr + length, flags & (VMA_READ | VMA_WRITE));
+    if (!vma) return 0;
+
+    mm->root = vma_insert(mm->root, vma);
+    mm->num_areas++;
+    mm->reserved += length;
+    return addr;
+}
+
+// Remove a range from the address space
+bool mm_unmap(mm_t *mm, uint32_t addr, uint32_t length) {
+    if ((addr & (PAGE_SIZE - 1)) || length == 0 || addr < MMAP_BASE ||
+        length > MMAP_END - addr) {
+        return false;
+    }
+    uint32_t end = addr + ((length + PAGE_SIZE - 1) & ~(PAGE_SIZE - 1));
+    if (end > MMAP_END) {
+        end = MMAP_END;
+    }
+
+    vma_t *vma;
+    while ((vma = vma_overlap(mm, addr, end)) != NULL) {
+        if (vma->start < addr && vma->end > end) {
+            // Punch a hole: the part above the range becomes its own area
+            vma_t *upper = vma_new(end, vma->end, vma->flags);
+            if (!upper) return false;
+            release_range(mm, addr, end);
+            vma->end = addr;
+            mm->root = vma_insert(mm->root, upper);
+            mm->num_areas++;
+            mm->reserved -= end - addr;
+        } else if (vma->start < addr) {
+            release_range(mm, addr, vma->end);
+            mm->reserved -= vma->end - addr;
+            vma->end = addr;
+        } else if (vma->end > end) {
+            release_range(mm, vma->start, end);
+            mm->reserved -= end - vma->start;
+            vma->start = end;
+        } else {
+            release_range(mm, vma->start, vma->end);
+            mm->reserved -= vma->end - vma->start;
+            mm->root = vma_remove(mm->root, vma);
+            mm->num_areas--;
+            kmem_cache_free(vma_cache, vma);
+        }
+    }
+    return true;
+}
+
+// Back a page of an area on first touch
+bool vma_handle_fault(uint32_t addr, uint32_t error) {
+    if (!current_mm || (error & PF_PRESENT)) return false;
+
+    // A PROT_NONE area has no access at all
+    vma_t *vma = vma_find(current_mm, addr);
+    if (!vma || !(vma->flags & VMA_READ) ||
+        ((error & PF_WRITE) && !(vma->flags & VMA_WRITE))) {
+        return false;
+    }
+
+    uint32_t frame = zpool_alloc_frame();
+    if (!frame) return false;
+
+    uint32_t flags = (vma->flags & VMA_WRITE) ? PTE_WRITE : 0;
+    if (!vmm_map_user(current_mm->directory, addr & ~(PAGE_SIZE - 1), frame, flags)) {
+        pmm_free_frame(frame);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,71 @@
+#ifndef KERNEL_VMA_H
+#define KERNEL_VMA_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Virtual memory areas
+// Each address space keeps its user mappings as non-overlapping areas in an
+// AVL tree keyed by start address. Areas are reserved without backing; the
+// page fault handler maps a zeroed frame on first touch.
+
+// Where mmap() places areas in the user half
+#define MMAP_BASE 0x40000000
+#define MMAP_END  0xC0000000
+
+// Area flags
+#define VMA_READ  0x1
+#define VMA_WRITE 0x2
+
+typedef struct vma {
+    uint32_t start;         // Page aligned
+    uint32_t end;           // Exclusive, page aligned
+    uint32_t flags;
+    struct vma *left;
+    struct vma *right;
+    int32_t height;         // AVL subtree height
+} vma_t;
+
+typedef struct mm {
+    uint32_t directory;     // Physical address of the page directory
+    vma_t *root;
+    uint32_t num_areas;
+    uint32_t reserved;      // Bytes covered by areas
+} mm_t;
+
+// Set up the area cache
+void vma_init(void);
+
+// Address space around an existing page directory, or NULL when out of
+// memory
+mm_t *mm_create(uint32_t directory);
+
+// Copy-on-write copy of an address space, or NULL when out of memory
+mm_t *mm_clone(mm_t *mm);
+
+// Free an address space, its areas and its page directory
+void mm_destroy(mm_t *mm);
+
+// Run in `mm` from now on
+void mm_switch(mm_t *mm);
+
+// Address space of the running code
+mm_t *mm_current(void);
+
+// Area containing `addr`, or NULL
+vma_t *vma_find(mm_t *mm, uint32_t addr);
+
+// Reserve `length` bytes of anonymous memory, at `addr` when that range is
+// free and page aligned, otherwise wherever it fits. Returns the start of
+// the area, or 0 when no range is free or out of memory.
+uint32_t mm_map(mm_t *mm, uint32_t addr, uint32_t length, uint32_t flags);
+
+// Remove [addr, addr + length) from the address space and free the frames
+// backing it. Areas partly covered are trimmed or split.
+bool mm_unmap(mm_t *mm, uint32_t addr, uint32_t length);
+
+// Back a page of an area in the running address space; false when `addr`
+// is not in an area or the access is not allowed
+bool vma_handle_fault(uint32_t addr, uint32_t error);
+
+#endif // KERNEL_VMA_H
@@ -0,0 +1,347 @@
+#include "vmm.h"
+#include "kernel.h"
+#include "pmm.h"
+#include "cpu.h"
+#include "memory.h"
+#include "zeropool.h"
+#include "vma.h"
+#include "terminal.h"
+#include "../bios/bios.h"
+
+// Virtual memory manager
+// The kernel page directory maps RAM at KERNEL_VIRTUAL_BASE with 4 MB pages,
+// marked global when the CPU supports it so kernel TLB entries survive CR3
+// reloads. Page tables are only allocated for 4 KB mappings made through
+// vmm_map().
+//
+// Other directories copy the kernel PDEs when created and share the kernel
+// page tables. A kernel page table created afterwards is copied into the
+// running directory by the page fault handler the first time it is needed.
+
+#define PDE_INDEX(addr) ((addr) >> 22)
+#define PTE_INDEX(addr) (((addr) >> 12) & 0x3FF)
+
+#define CR4_PGE 0x80
+#define CR0_WP  0x10000
+
+// First page directory entry of the kernel half
+#define KERNEL_PDE PDE_INDEX(KERNEL_VIRTUAL_BASE)
+
+static uint32_t kernel_directory[1024] __attribute__((aligned(PAGE_SIZE)));
+static uint32_t *current_directory = kernel_directory;
+static uint32_t cow_faults = 0;
+
+static inline uint32_t read_cr4(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr4, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr4(uint32_t value) {
+    asm volatile ("mov %0, %%cr4" : : "r"(value) : "memory");
+}
+
+static inline uint32_t read_cr0(void) {
+    uint32_t value;
+    asm volatile ("mov %%cr0, %0" : "=r"(value));
+    return value;
+}
+
+static inline void write_cr0(uint32_t value) {
+    asm volatile ("mov %0, %%cr0" : : "r"(value) : "memory");
+}
+
+static inline void load_cr3(uint32_t directory) {
+    asm volatile ("mov %0, %%cr3" : : "r"(directory) : "memory");
+}
+
+static inline void invlpg(uint32_t virt) {
+    asm volatile ("invlpg (%0)" : : "r"(virt) : "memory");
+}
+
+// End of the highest RAM range in the E820 map, clipped to the direct map.
+// The first 4 MB are always mapped: they hold the kernel and VGA memory.
+static uint32_t ram_top(void) {
+    uint32_t num_entries = *(uint32_t*)PHYS_TO_VIRT(E820_MAP_ADDR);
+    e820_entry_t *mem_map = (e820_entry_t*)PHYS_TO_VIRT(E820_ENTRIES_ADDR);
+    uint32_t top = LARGE_PAGE_SIZE;
+
+    for (uint32_t i = 0; i < num_entries; i++) {
+        if (mem_map[i].type != E820_RAM || mem_map[i].base >= DIRECT_MAP_SIZE) {
+            continue;
+        }
+        uint64_t end = mem_map[i].base + mem_map[i].length;
+        if (end > DIRECT_MAP_SIZE) {
+            end = DIRECT_MAP_SIZE;
+        }
+        if (end > top) {
+            top = (uint32_t)end;
+        }
+    }
+
+    return top;
+}
+
+// Build the kernel page directory and switch to it
+void vmm_init(void) {
+    cpu_info_t *cpu = cpu_get_info();
+    if (!cpu->has_pse) {
+        panic("vmm_init: CPU does not support 4 MB pages");
+    }
+
+    uint32_t global = 0;
+    if (cpu->has_pge) {
+        write_cr4(read_cr4() | CR4_PGE);
+        global = PTE_GLOBAL;
+    }
+
+    memset(kernel_directory, 0, sizeof(kernel_directory));
+
+    uint32_t top = ram_top();
+    for (uint32_t phys = 0; phys < top; phys += LARGE_PAGE_SIZE) {
+        kernel_directory[PDE_INDEX(KERNEL_VIRTUAL_BASE + phys)] =
+            phys | PTE_PRESENT | PTE_WRITE | PTE_LARGE | global;
+    }
+
+    load_cr3(VIRT_TO_PHYS(kernel_directory));
+
+    // Make read-only pages fault on kernel writes too, so system calls
+    // writing to user memory break copy-on-write sharing
+    write_cr0(read_cr0() | CR0_WP);
+}
+
+// Map a 4 KB page in the directory `pd`
+static bool map_page(uint32_t *pd, uint32_t virt, uint32_t phys, uint32_t flags) {
+    uint32_t *pde = &pd[PDE_INDEX(virt)];
+    if (*pde & PTE_LARGE) return false;
+
+    if (!(*pde & PTE_PRESENT)) {
+        uint32_t table = zpool_alloc_frame();
+        if (!table) return false;
+        *pde = table | PTE_PRESENT | PTE_WRITE | (flags & PTE_USER);
+    }
+
+    uint32_t *table = (uint32_t*)PHYS_TO_VIRT(*pde & PTE_FRAME_MASK);
+    table[PTE_INDEX(virt)] = (phys & PTE_FRAME_MASK) |
+                             (flags & ~(PTE_FRAME_MASK | PTE_LARGE)) | PTE_PRESENT;
+    invlpg(virt);
+    return true;
+}
+
+// Remove a 4 KB mapping from the directory `pd`
+static uint32_t unmap_page(uint32_t *pd, uint32_t virt) {
+    uint32_t pde = pd[PDE_INDEX(virt)];
+    if (!(pde & PTE_PRESENT) || (pde & PTE_LARGE)) return 0;
+
+    uint32_t *table = (uint32_t*)PHYS_TO_VIRT(pde & PTE_FRAME_MASK);
+    uint32_t pte = table[PTE_INDEX(virt)];
+    if (!(pte & PTE_PRESENT)) return 0;
+
+    table[PTE_INDEX(virt)] = 0;
+    invlpg(virt);
+    return pte & PTE_FRAME_MASK;
+}
+
+// Map a 4 KB page
+bool vmm_map(uint32_t virt, uint32_t phys, uint32_t flags) {
+    return map_page(kernel_directory, virt, phys, flags);
+}
+
+// Map a 4 KB user page in a directory
+bool vmm_map_user(uint32_t dir, uint32_t virt, uint32_t phys, uint32_t flags) {
+    if (virt >= KERNEL_VIRTUAL_BASE) return false;
+    return map_page((uint32_t*)PHYS_TO_VIRT(dir), virt, phys, flags | PTE_USER);
+}
+
+// Remove a 4 KB user mapping from a directory
+uint32_t vmm_unmap_user(uint32_t dir, uint32_t virt) {
+    if (virt >= KERNEL_VIRTUAL_BASE) return 0;
+    return unmap_page((uint32_t*)PHYS_TO_VIRT(dir), virt);
+}
+
+// Create the page tables covering a range
+bool vmm_reserve(uint32_t start, uint32_t end) {
+    for (uint32_t addr = start & ~(LARGE_PAGE_SIZE - 1); addr < end; addr += LARGE_PAGE_SIZE) {
+        uint32_t *pde = &kernel_directory[PDE_INDEX(addr)];
+        if (*pde & PTE_PRESENT) continue;
+
+        uint32_t table = zpool_alloc_frame();
+        if (!table) return false;
+        *pde = table | PTE_PRESENT | PTE_WRITE;
+    }
+    return true;
+}
+
+// Remove a 4 KB mapping
+uint32_t vmm_unmap(uint32_t virt) {
+    return unmap_page(kernel_directory, virt);
+}
+
+// Translate a virtual address through the kernel page directory
+uint32_t vmm_translate(uint32_t virt) {
+    uint32_t pde = kernel_directory[PDE_INDEX(virt)];
+    if (!(pde & PTE_PRESENT)) return 0;
+    if (pde & PTE_LARGE) {
+        return (pde & ~(LARGE_PAGE_SIZE - 1)) | (virt & (LARGE_PAGE_SIZE - 1));
+    }
+
+    uint32_t *table = (uint32_t*)PHYS_TO_VIRT(pde & PTE_FRAME_MASK);
+    uint32_t pte = table[PTE_INDEX(virt)];
+    if (!(pte & PTE_PRESENT)) return 0;
+    return (pte & PTE_FRAME_MASK) | (virt & (PAGE_SIZE - 1));
+}
+
+uint32_t vmm_get_directory(void) {
+    return VIRT_TO_PHYS(kernel_directory);
+}
+
+// Create a directory with an empty user half
+uint32_t vmm_create_directory(void) {
+    uint32_t dir = zpool_alloc_frame();
+    if (!dir) return 0;
+
+    uint32_t *pd = (uint32_t*)PHYS_TO_VIRT(dir);
+    for (uint32_t i = KERNEL_PDE; i < 1024; i++) {
+        pd[i] = kernel_directory[i];
+    }
+    return dir;
+}
+
+// Copy-on-write clone of the user half of a directory
+uint32_t vmm_clone_directory(uint32_t dir) {
+    uint32_t *src = (uint32_t*)PHYS_TO_VIRT(dir);
+    uint32_t clone = vmm_create_directory();
+    if (!clone) return 0;
+    uint32_t *dst = (uint32_t*)PHYS_TO_VIRT(clone);
+
+    for (uint32_t i = 0; i < KERNEL_PDE; i++) {
+        // The user half only holds 4 KB mappings
+        if (!(src[i] & PTE_PRESENT) || (src[i] & PTE_LARGE)) continue;
+
+        uint32_t table = zpool_alloc_frame();
+        if (!table) {
+            vmm_free_directory(clone);
+            return 0;
+        }
+        dst[i] = table | (src[i] & ~PTE_FRAME_MASK);
+
+        uint32_t *src_table = (uint32_t*)PHYS_TO_VIRT(src[i] & PTE_FRAME_MASK);
+        uint32_t *dst_table = (uint32_t*)PHYS_TO_VIRT(table);
+        for (uint32_t j = 0; j < 1024; j++) {
+            uint32_t pte = src_table[j];
+            if (!(pte & PTE_PRESENT)) continue;
+
+            if (pte & PTE_WRITE) {
+                pte = (pte & ~PTE_WRITE) | PTE_COW;
+                src_table[j] = pte;
+            }
+            dst_table[j] = pte;
+            pmm_frame_share(pte & PTE_FRAME_MASK);
+        }
+    }
+
+    // Drop the writable TLB entries of the pages just shared
+    if (src == current_directory) {
+        load_cr3(dir);
+    }
+    return clone;
+}
+
+// Release the user half of a directory and the directory itself
+void vmm_free_directory(uint32_t dir) {
+    uint32_t *pd = (uint32_t*)PHYS_TO_VIRT(dir);
+    if (pd == kernel_directory || pd == current_directory) {
+        panic("vmm_free_directory: directory is in use");
+    }
+
+    for (uint32_t i = 0; i < KERNEL_PDE; i++) {
+        if (!(pd[i] & PTE_PRESENT) || (pd[i] & PTE_LARGE)) continue;
+
+        uint32_t *table = (uint32_t*)PHYS_TO_VIRT(pd[i] & PTE_FRAME_MASK);
+        for (uint32_t j = 0; j < 1024; j++) {
+            if (table[j] & PTE_PRESENT) {
+                pmm_frame_release(table[j] & PTE_FRAME_MASK);
+            }
+        }
+        pmm_free_frame(pd[i] & PTE_FRAME_MASK);
+    }
+    pmm_free_frame(dir);
+}
+
+// Load a directory into CR3
+void vmm_switch_directory(uint32_t dir) {
+    current_directory = (uint32_t*)PHYS_TO_VIRT(dir);
+    load_cr3(dir);
+}
+
+uint32_t vmm_get_cow_faults(void) {
+    return cow_faults;
+}
+
+// Copy a kernel page table the running directory does not have yet
+static bool sync_kernel_pde(uint32_t address) {
+    uint32_t index = PDE_INDEX(address);
+    if (index < KERNEL_PDE || current_directory == kernel_directory) return false;
+    if (!(kernel_directory[index] & PTE_PRESENT) ||
+        current_directory[index] == kernel_directory[index]) {
+        return false;
+    }
+
+    current_directory[index] = kernel_directory[index];
+    return true;
+}
+
+// Give the writer of a copy-on-write page its own copy. The last mapping of
+// a frame just gets write access back.
+static bool cow_fault(uint32_t address) {
+    uint32_t pde = current_directory[PDE_INDEX(address)];
+    if (!(pde & PTE_PRESENT) || (pde & PTE_LARGE)) return false;
+
+    uint32_t *table = (uint32_t*)PHYS_TO_VIRT(pde & PTE_FRAME_MASK);
+    uint32_t *pte = &table[PTE_INDEX(address)];
+    if (!(*pte & PTE_COW)) return false;
+
+    uint32_t frame = *pte & PTE_FRAME_MASK;
+    uint32_t flags = (*pte & ~(PTE_FRAME_MASK | PTE_COW)) | PTE_WRITE;
+    if (pmm_frame_is_shared(frame)) {
+        uint32_t copy = pmm_alloc_frame();
+        if (!copy) return false;
+        memcpy(PHYS_TO_VIRT(copy), PHYS_TO_VIRT(frame), PAGE_SIZE);
+        *pte = copy | flags;
+        pmm_frame_release(frame);
+    } else {
+        *pte = frame | flags;
+    }
+
+    invlpg(address);
+    cow_faults++;
+    return true;
+}
+
+// Page fault handler
+void page_fault_handler(uint32_t error, uint32_t address) {
+    if (!(error & PF_PRESENT)) {
+        // Kernel page tables added since this directory was created
+        if (sync_kernel_pde(address)) {
+            return;
+        }
+        // Missing heap pages are backed on first touch
+        if (heap_handle_fault(address)) {
+            return;
+        }
+    } else if ((error & PF_WRITE) && cow_fault(address)) {
+        return;
+    }
+
+    // Anonymous user memory is backed on first touch
+    if (address < KERNEL_VIRTUAL_BASE && vma_handle_fault(address, error)) {
+        return;
+    }
+
+    terminal_puts("\nPage fault at ");
+    terminal_put_hex(address);
+    terminal_puts(", error ");
+    terminal_put_hex(error);
+    terminal_puts("\n");
+    panic("Unhandled page fault");
+}
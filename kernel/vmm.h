@@ -0,0 +1,96 @@
+#ifndef KERNEL_VMM_H
+#define KERNEL_VMM_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Virtual memory layout
+//   0x00000000 - 0xBFFFFFFF  Unmapped (reserved for user space)
+//   0xC0000000 - 0xDFFFFFFF  Direct map of physical RAM, kernel image included
+//   0xE0000000 - 0xEFFFFFFF  Kernel heap, backed on demand
+//   0xF0000000 - 0xFEFFFFFF  4 KB mappings made with vmm_map()
+//   0xFF000000 - 0xFFBFFFFF  Kernel stacks with guard pages (kstack.h)
+#define KERNEL_VIRTUAL_BASE 0xC0000000
+#define DIRECT_MAP_SIZE     0x20000000   // RAM above 512 MB is not used
+#define HEAP_VIRTUAL_START  0xE0000000
+#define HEAP_VIRTUAL_END    0xF0000000
+#define VMM_MAP_START       0xF0000000
+#define VMM_MAP_END         0xFF000000
+#define KSTACK_START        0xFF000000
+#define KSTACK_END          0xFFC00000
+
+// Convert between physical addresses and their direct-map alias
+#define PHYS_TO_VIRT(addr) ((void*)((uint32_t)(addr) + KERNEL_VIRTUAL_BASE))
+#define VIRT_TO_PHYS(addr) ((uint32_t)(addr) - KERNEL_VIRTUAL_BASE)
+
+// Page directory and page table entry flags
+#define PTE_PRESENT      0x001
+#define PTE_WRITE        0x002
+#define PTE_USER         0x004
+#define PTE_WRITETHROUGH 0x008
+#define PTE_NOCACHE      0x010
+#define PTE_LARGE        0x080   // 4 MB page (page directory entries only)
+#define PTE_GLOBAL       0x100   // Survives CR3 reloads
+#define PTE_COW          0x200   // Read-only until written, then copied (software bit)
+
+#define PTE_FRAME_MASK   0xFFFFF000
+#define LARGE_PAGE_SIZE  0x400000
+
+// Build the kernel page directory and switch to it; the identity map left
+// by the boot code is dropped
+void vmm_init(void);
+
+// Map the 4 KB page at `virt` to the frame at `phys`. Returns false when a
+// page table cannot be allocated or `virt` is covered by a 4 MB page.
+bool vmm_map(uint32_t virt, uint32_t phys, uint32_t flags);
+
+// Create the page tables covering [start, end) in the kernel half now
+// rather than on first use. Returns false when out of memory.
+bool vmm_reserve(uint32_t start, uint32_t end);
+
+// Remove the 4 KB mapping at `virt`. Returns the frame it mapped, or 0.
+uint32_t vmm_unmap(uint32_t virt);
+
+// Physical address `virt` maps to, or 0 when it is not mapped
+uint32_t vmm_translate(uint32_t virt);
+
+// Physical address of the kernel page directory
+uint32_t vmm_get_directory(void);
+
+// User address spaces
+// A page directory shares the kernel half (KERNEL_VIRTUAL_BASE and up) with
+// the kernel directory; page tables the kernel adds later are picked up on
+// first use. The user half is private to each directory.
+
+// Create a directory with an empty user half. Returns its physical address,
+// or 0 when out of memory.
+uint32_t vmm_create_directory(void);
+
+// Copy-on-write clone of `dir`: the user half of both directories maps the
+// same frames read-only, and the first write to a page gives the writer its
+// own copy. Returns the new directory, or 0 when out of memory.
+uint32_t vmm_clone_directory(uint32_t dir);
+
+// Release the user half of a directory and the directory itself
+void vmm_free_directory(uint32_t dir);
+
+// Load a directory into CR3
+void vmm_switch_directory(uint32_t dir);
+
+// Map and unmap 4 KB pages in the user half of a directory; the page is
+// always made accessible from user mode
+bool vmm_map_user(uint32_t dir, uint32_t virt, uint32_t phys, uint32_t flags);
+uint32_t vmm_unmap_user(uint32_t dir, uint32_t virt);
+
+// Copy-on-write faults handled since boot
+uint32_t vmm_get_cow_faults(void);
+
+// Page fault error code bits
+#define PF_PRESENT 0x01   // Protection violation rather than a missing page
+#define PF_WRITE   0x02
+#define PF_USER    0x04
+
+// Page fault handler, called from interrupts.asm with CR2 in `address`
+void page_fault_handler(uint32_t error, uint32_t address);
+
+#endif // KERNEL_VMM_H
@@ -0,0 +1,124 @@
+#include "zeropool.h"
+#include "kernel.h"
+#include "util.h"
+#include "cpu.h"
+#include "pmm.h"
+#include "vmm.h"
+#include "shrinker.h"
+
+// Zeroed frame pool
+// Pooled frames are linked through their first word, which is cleared again
+// when the frame is handed out. The pool only grows while the page frame
+// allocator has more than ZPOOL_MAX frames to spare.
+
+static uint32_t *pool = NULL;   // First pooled frame (direct-map address)
+static uint32_t pool_count = 0;
+
+// Zero with non-temporal stores so refilling the pool does not evict the
+// cache. The kernel does not save SSE state, and this runs from the page
+// fault path in the middle of the libc SSE2 routines, so xmm0 is saved and
+// restored around the loop like they do.
+static void zero_page_sse2(void *page) {
+    uint32_t count = PAGE_SIZE / 64;
+    uint8_t saved[16];
+    asm volatile (
+        "movdqu %%xmm0, (%2)\n\t"
+        "pxor %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movntdq %%xmm0, 0(%0)\n\t"
+        "movntdq %%xmm0, 16(%0)\n\t"
+        "movntdq %%xmm0, 32(%0)\n\t"
+        "movntdq %%xmm0, 48(%0)\n\t"
+        "add $64, %0\n\t"
+        "dec %1\n\t"
+        "jnz 1b\n\t"
+        "sfence\n\t"
+        "movdqu (%2), %%xmm0"
+        : "+r"(page), "+r"(count)
+        : "r"(saved)
+        : "memory", "cc");
+}
+
+// Zero a 4 KB page
+void zero_page(void *page) {
+    if (cpu_get_info()->has_sse2) {
+        zero_page_sse2(page);
+        return;
+    }
+
+    uint32_t count = PAGE_SIZE / 4;
+    asm volatile ("rep stosl" : "+D"(page), "+c"(count) : "a"(0) : "memory");
+}
+
+// Give pooled frames back under memory pressure; they are the cheapest
+// thing to rebuild
+static size_t zpool_shrink(size_t target) {
+    size_t freed = 0;
+
+    while (freed < target) {
+        uint32_t flags = irq_save();
+        uint32_t *frame = pool;
+        if (frame) {
+            pool = (uint32_t*)*frame;
+            pool_count--;
+        }
+        irq_restore(flags);
+
+        if (!frame) break;
+        pmm_free_frame(VIRT_TO_PHYS(frame));
+        freed += PAGE_SIZE;
+    }
+
+    return freed;
+}
+
+static shrinker_t zpool_shrinker = { "zeropool", zpool_shrink, 0, 0, 0, NULL };
+
+void zpool_init(void) {
+    shrinker_register(&zpool_shrinker);
+}
+
+// Take a zeroed frame
+uint32_t zpool_alloc_frame(void) {
+    uint32_t flags = irq_save();
+    uint32_t *frame = pool;
+    if (frame) {
+        pool = (uint32_t*)*frame;
+        pool_count--;
+    }
+    irq_restore(flags);
+
+    if (frame) {
+        *frame = 0;
+        return VIRT_TO_PHYS(frame);
+    }
+
+    uint32_t addr = pmm_alloc_frame();
+    if (addr) {
+        zero_page(PHYS_TO_VIRT(addr));
+    }
+    return addr;
+}
+
+// Zero a batch of frames into the pool
+bool zpool_refill(void) {
+    uint32_t done = 0;
+
+    while (done < ZPOOL_BATCH && pool_count < ZPOOL_MAX &&
+           pmm_get_free_frames() > ZPOOL_MAX) {
+        uint32_t addr = pmm_alloc_frame();
+        if (!addr) break;
+
+        uint32_t *frame = (uint32_t*)PHYS_TO_VIRT(addr);
+        zero_page(frame);
+
+        uint32_t flags = irq_save();
+        *frame = (uint32_t)pool;
+        pool = frame;
+        pool_count++;
+        irq_restore(flags);
+        done++;
+    }
+
+    return done > 0;
+}
@@ -0,0 +1,28 @@
+#ifndef KERNEL_ZEROPOOL_H
+#define KERNEL_ZEROPOOL_H
+
+#include <stdint.h>
+#include <stdbool.h>
+
+// Pool of pre-zeroed page frames
+// Frames are zeroed while the CPU would otherwise sit in hlt, so handing out
+// a zeroed frame is a list pop.
+
+#define ZPOOL_MAX   64      // Frames kept zeroed
+#define ZPOOL_BATCH 4       // Frames zeroed per zpool_refill() call
+
+// Register the pool with the shrinkers
+void zpool_init(void);
+
+// Zero a 4 KB page
+void zero_page(void *page);
+
+// Take a zeroed frame: from the pool, or zeroed on the spot when the pool is
+// empty. Returns the physical address, or 0 when out of memory.
+uint32_t zpool_alloc_frame(void);
+
+// Zero up to ZPOOL_BATCH frames into the pool. Returns true when it did
+// any work, so idle loops know whether to halt.
+bool zpool_refill(void);
+
+#endif // KERNEL_ZEROPOOL_H
@@ -14,8 +14,8 @@ typedef unsigned int uint32_t;
 typedef unsigned long long uint64_t;
 
 // Pointers and size types
-typedef int32_t intptr_t;
-typedef uint32_t uintptr_t;
+typedef __INTPTR_TYPE__ intptr_t;
+typedef __UINTPTR_TYPE__ uintptr_t;
 typedef int32_t intmax_t;
 typedef uint32_t uintmax_t;
 
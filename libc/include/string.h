@@ -8,6 +8,8 @@ void* memcpy(void* dest, const void* src, size_t n);
 void* memset(void* s, int c, size_t n);
 int memcmp(const void* s1, const void* s2, size_t n);
 void* memmove(void* dest, const void* src, size_t n);
+void* memchr(const void* s, int c, size_t n);
+void* memmem(const void* haystack, size_t n, const void* needle, size_t m);
 
 // String functions
 size_t strlen(const char* s);
@@ -17,8 +19,23 @@ int strcmp(const char* s1, const char* s2);
 int strncmp(const char* s1, const char* s2, size_t n);
 char* strcat(char* dest, const char* src);
 char* strncat(char* dest, const char* src, size_t n);
+char* strchr(const char* s, int c);
+char* strstr(const char* haystack, const char* needle);
 
 // Conversion functions
 char* itoa(int value, char* str, int base);
 
+// CPU features string_init() can use
+#define STRING_ERMS 0x1     // Fast rep movsb/stosb
+#define STRING_SSE2 0x2     // SSE2 enabled
+
+// Select the memcpy/memset routines for the CPU, once at boot
+void string_init(int features);
+
+// Check memcpy, memmove and memset against byte-wise copies, including
+// misaligned heads and tails and overlapping moves, and the string scanners
+// and memmem against byte-wise loops. Returns 0 when they
+// agree, otherwise the length of the first failing case plus one.
+size_t string_selftest(void);
+
 #endif // _STRING_H
@@ -1,25 +1,288 @@
 #include "libc/include/string.h"
+#include "libc/include/stdint.h"
 
-void* memcpy(void* dest, const void* src, size_t n) {
+// Memory copy and fill
+// memcpy() and memset() go through pointers chosen once at boot by
+// string_init(). The defaults use rep movsd/stosd, which every x86 CPU
+// supports, so they are safe to call before the CPU has been probed.
+
+// Copies at least this long take the SSE2 path when it is selected
+#define SSE2_COPY_MIN 256
+
+static void* memcpy_rep(void* dest, const void* src, size_t n);
+static void* memset_rep(void* s, int c, size_t n);
+
+static void* (*memcpy_impl)(void*, const void*, size_t) = memcpy_rep;
+static void* (*memset_impl)(void*, int, size_t) = memset_rep;
+static int string_features = 0;
+
+// Unaligned, aliasing-safe word access
+typedef uint32_t __attribute__((may_alias, aligned(1))) word_t;
+
+// Byte copy
+static inline void copy_bytes(void* dest, const void* src, size_t n) {
+    asm volatile ("rep movsb" : "+D"(dest), "+S"(src), "+c"(n) : : "memory");
+}
+
+// Copy with rep movsd after aligning the destination
+static void* memcpy_rep(void* dest, const void* src, size_t n) {
     char* d = (char*)dest;
     const char* s = (const char*)src;
-    for (size_t i = 0; i < n; i++) {
-        d[i] = s[i];
+
+    if (n >= 16) {
+        size_t head = -(size_t)d & 3;
+        copy_bytes(d, s, head);
+        d += head;
+        s += head;
+        n -= head;
     }
+
+    size_t dwords = n >> 2;
+    asm volatile ("rep movsl" : "+D"(d), "+S"(s), "+c"(dwords) : : "memory");
+    copy_bytes(d, s, n & 3);
     return dest;
 }
 
-void* memset(void* s, int c, size_t n) {
+// Enhanced rep movsb: the microcode picks the best chunking itself
+static void* memcpy_erms(void* dest, const void* src, size_t n) {
+    copy_bytes(dest, src, n);
+    return dest;
+}
+
+// 64 bytes per iteration through xmm0-xmm3 into an aligned destination.
+// The kernel does not save SSE state across interrupts, so the registers
+// are saved and restored around the loop; an interrupt handler copying in
+// the middle of it does the same and leaves them intact.
+static void* memcpy_sse2(void* dest, const void* src, size_t n) {
+    if (n < SSE2_COPY_MIN) {
+        return string_features & STRING_ERMS ? memcpy_erms(dest, src, n)
+                                             : memcpy_rep(dest, src, n);
+    }
+
+    char* d = (char*)dest;
+    const char* s = (const char*)src;
+    size_t head = -(size_t)d & 15;
+    copy_bytes(d, s, head);
+    d += head;
+    s += head;
+    n -= head;
+
+    // The kernel stack is not kept 16-byte aligned, so no movdqa here
+    uint8_t saved[64];
+    size_t blocks = n >> 6;
+    asm volatile (
+        "movdqu %%xmm0, 0(%3)\n\t"
+        "movdqu %%xmm1, 16(%3)\n\t"
+        "movdqu %%xmm2, 32(%3)\n\t"
+        "movdqu %%xmm3, 48(%3)\n\t"
+        "1:\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movdqa %%xmm0, 0(%0)\n\t"
+        "movdqa %%xmm1, 16(%0)\n\t"
+        "movdqa %%xmm2, 32(%0)\n\t"
+        "movdqa %%xmm3, 48(%0)\n\t"
+        "add $64, %1\n\t"
+        "add $64, %0\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "movdqu 0(%3), %%xmm0\n\t"
+        "movdqu 16(%3), %%xmm1\n\t"
+        "movdqu 32(%3), %%xmm2\n\t"
+        "movdqu 48(%3), %%xmm3"
+        : "+r"(d), "+r"(s), "+r"(blocks)
+        : "r"(saved)
+        : "memory", "cc");
+
+    copy_bytes(d, s, n & 63);
+    return dest;
+}
+
+// Fill with rep stosd after aligning the destination
+static void* memset_rep(void* s, int c, size_t n) {
     unsigned char* p = (unsigned char*)s;
-    for (size_t i = 0; i < n; i++) {
-        p[i] = (unsigned char)c;
+    uint32_t pattern = (unsigned char)c * 0x01010101U;
+
+    if (n >= 16) {
+        size_t head = -(size_t)p & 3;
+        n -= head;
+        asm volatile ("rep stosb" : "+D"(p), "+c"(head) : "a"(pattern) : "memory");
     }
+
+    size_t dwords = n >> 2;
+    size_t tail = n & 3;
+    asm volatile ("rep stosl" : "+D"(p), "+c"(dwords) : "a"(pattern) : "memory");
+    asm volatile ("rep stosb" : "+D"(p), "+c"(tail) : "a"(pattern) : "memory");
+    return s;
+}
+
+static void* memset_erms(void* s, int c, size_t n) {
+    void* p = s;
+    asm volatile ("rep stosb" : "+D"(p), "+c"(n) : "a"(c) : "memory");
     return s;
 }
 
+// Pick the copy and fill routines for the CPU; features are STRING_*
+void string_init(int features) {
+    string_features = features;
+
+    if (features & STRING_SSE2) {
+        memcpy_impl = memcpy_sse2;
+    } else if (features & STRING_ERMS) {
+        memcpy_impl = memcpy_erms;
+    } else {
+        memcpy_impl = memcpy_rep;
+    }
+    memset_impl = (features & STRING_ERMS) ? memset_erms : memset_rep;
+}
+
+void* memcpy(void* dest, const void* src, size_t n) {
+    return memcpy_impl(dest, src, n);
+}
+
+void* memset(void* s, int c, size_t n) {
+    return memset_impl(s, c, n);
+}
+
+// Copy backward 64 bytes at a time through xmm0-xmm3, ending with `d`
+// aligned; registers are saved as in memcpy_sse2()
+static void copy_back_sse2(char* d, const char* s, size_t blocks) {
+    uint8_t saved[64];
+    asm volatile (
+        "movdqu %%xmm0, 0(%3)\n\t"
+        "movdqu %%xmm1, 16(%3)\n\t"
+        "movdqu %%xmm2, 32(%3)\n\t"
+        "movdqu %%xmm3, 48(%3)\n\t"
+        "1:\n\t"
+        "sub $64, %1\n\t"
+        "sub $64, %0\n\t"
+        "movdqu 0(%1), %%xmm0\n\t"
+        "movdqu 16(%1), %%xmm1\n\t"
+        "movdqu 32(%1), %%xmm2\n\t"
+        "movdqu 48(%1), %%xmm3\n\t"
+        "movdqa %%xmm0, 0(%0)\n\t"
+        "movdqa %%xmm1, 16(%0)\n\t"
+        "movdqa %%xmm2, 32(%0)\n\t"
+        "movdqa %%xmm3, 48(%0)\n\t"
+        "dec %2\n\t"
+        "jnz 1b\n\t"
+        "movdqu 0(%3), %%xmm0\n\t"
+        "movdqu 16(%3), %%xmm1\n\t"
+        "movdqu 32(%3), %%xmm2\n\t"
+        "movdqu 48(%3), %%xmm3"
+        : "+r"(d), "+r"(s), "+r"(blocks)
+        : "r"(saved)
+        : "memory", "cc");
+}
+
+// The backward copy never sets the direction flag: interrupt handlers would
+// run with it set, and rep stos/movs there would write downwards. Every
+// read is from below everything written so far, so overlap is safe.
+void* memmove(void* dest, const void* src, size_t n) {
+    char* d = (char*)dest;
+    const char* s = (const char*)src;
+
+    // A forward copy is safe unless the destination starts inside the source
+    if (d <= s || d >= s + n) {
+        return memcpy_impl(dest, src, n);
+    }
+
+    d += n;
+    s += n;
+    if ((string_features & STRING_SSE2) && n >= SSE2_COPY_MIN) {
+        size_t tail = (size_t)d & 15;
+        n -= tail;
+        while (tail--) {
+            *--d = *--s;
+        }
+        size_t blocks = n >> 6;
+        copy_back_sse2(d, s, blocks);
+        d -= blocks << 6;
+        s -= blocks << 6;
+        n &= 63;
+    }
+
+    while (n >= 4) {
+        d -= 4;
+        s -= 4;
+        n -= 4;
+        *(word_t*)d = *(const word_t*)s;
+    }
+    while (n--) {
+        *--d = *--s;
+    }
+    return dest;
+}
+
+// String scanning
+// The scanners read a word at a time, or 16 bytes with SSE2. has_zero() is
+// nonzero when a word holds a zero byte, and its lowest set bit lies in the
+// first one. An aligned load never straddles a page, so reading the whole
+// word that holds a terminator cannot fault; unaligned loads are only made
+// within known bounds or away from the end of a page.
+
+#define ONES       0x01010101U
+#define HIGHS      0x80808080U
+#define PAGE_BYTES 4096
+
+// Scans longer than this take the SSE2 path, which pays for saving and
+// restoring the xmm registers it uses
+#define SSE2_SCAN_MIN 64
+
+static inline uint32_t has_zero(uint32_t w) {
+    return (w - ONES) & ~w & HIGHS;
+}
+
+// Byte index of the first zero flagged by has_zero()
+static inline size_t zero_index(uint32_t mask) {
+    return __builtin_ctz(mask) >> 3;
+}
+
+// Whether a word loaded from `p` could run into the next page
+static inline int near_page_end(const void* p) {
+    return ((uintptr_t)p & (PAGE_BYTES - 1)) > PAGE_BYTES - sizeof(uint32_t);
+}
+
 int memcmp(const void* s1, const void* s2, size_t n) {
     const unsigned char* p1 = (const unsigned char*)s1;
     const unsigned char* p2 = (const unsigned char*)s2;
+
+    // Skip equal 16-byte blocks, then equal words
+    if (n >= SSE2_SCAN_MIN && (string_features & STRING_SSE2)) {
+        uint8_t saved[32];
+        size_t blocks = n >> 4;
+        uint32_t mask;
+        asm volatile (
+            "movdqu %%xmm0, 0(%4)\n\t"
+            "movdqu %%xmm1, 16(%4)\n\t"
+            "1:\n\t"
+            "movdqu (%0), %%xmm0\n\t"
+            "movdqu (%1), %%xmm1\n\t"
+            "pcmpeqb %%xmm1, %%xmm0\n\t"
+            "pmovmskb %%xmm0, %3\n\t"
+            "cmp $0xFFFF, %3\n\t"
+            "jne 2f\n\t"
+            "add $16, %0\n\t"
+            "add $16, %1\n\t"
+            "dec %2\n\t"
+            "jnz 1b\n\t"
+            "2:\n\t"
+            "movdqu 0(%4), %%xmm0\n\t"
+            "movdqu 16(%4), %%xmm1"
+            : "+r"(p1), "+r"(p2), "+r"(blocks), "=&r"(mask)
+            : "r"(saved)
+            : "memory", "cc");
+        n -= p1 - (const unsigned char*)s1;
+    }
+
+    while (n >= 4 && *(const word_t*)p1 == *(const word_t*)p2) {
+        p1 += 4;
+        p2 += 4;
+        n -= 4;
+    }
+
     for (size_t i = 0; i < n; i++) {
         if (p1[i] != p2[i]) {
             return p1[i] - p2[i];
@@ -28,25 +291,232 @@ int memcmp(const void* s1, const void* s2, size_t n) {
     return 0;
 }
 
-void* memmove(void* dest, const void* src, size_t n) {
-    char* d = (char*)dest;
-    const char* s = (const char*)src;
-    if (d < s) {
-        for (size_t i = 0; i < n; i++) {
-            d[i] = s[i];
+void* memchr(const void* s, int c, size_t n) {
+    const unsigned char* p = (const unsigned char*)s;
+    unsigned char ch = (unsigned char)c;
+    uint32_t pattern = ch * ONES;
+
+    // 16 bytes at a time, stopping at the first block holding `ch`
+    if (n >= SSE2_SCAN_MIN && (string_features & STRING_SSE2)) {
+        uint8_t saved[32];
+        size_t blocks = n >> 4;
+        uint32_t mask;
+        asm volatile (
+            "movdqu %%xmm0, 0(%3)\n\t"
+            "movdqu %%xmm1, 16(%3)\n\t"
+            "movd %4, %%xmm0\n\t"
+            "pshufd $0, %%xmm0, %%xmm0\n\t"
+            "1:\n\t"
+            "movdqu (%0), %%xmm1\n\t"
+            "pcmpeqb %%xmm0, %%xmm1\n\t"
+            "pmovmskb %%xmm1, %2\n\t"
+            "test %2, %2\n\t"
+            "jnz 2f\n\t"
+            "add $16, %0\n\t"
+            "dec %1\n\t"
+            "jnz 1b\n\t"
+            "2:\n\t"
+            "movdqu 0(%3), %%xmm0\n\t"
+            "movdqu 16(%3), %%xmm1"
+            : "+r"(p), "+r"(blocks), "=&r"(mask)
+            : "r"(saved), "r"(pattern)
+            : "memory", "cc");
+        if (mask) return (void*)(p + __builtin_ctz(mask));
+        n -= p - (const unsigned char*)s;
+    }
+
+    while (n && ((uintptr_t)p & 3)) {
+        if (*p == ch) return (void*)p;
+        p++;
+        n--;
+    }
+
+    // A byte equal to `ch` becomes a zero byte after the xor
+    while (n >= 4) {
+        uint32_t z = has_zero(*(const word_t*)p ^ pattern);
+        if (z) return (void*)(p + zero_index(z));
+        p += 4;
+        n -= 4;
+    }
+
+    while (n--) {
+        if (*p == ch) return (void*)p;
+        p++;
+    }
+    return NULL;
+}
+
+// Substring search
+// Candidates are positions where both the first and the last byte of the
+// needle match; only those get a full compare. The SSE2 path tests 16
+// positions per step, the scalar one jumps between first bytes with
+// memchr().
+
+// Advance `*p` over 16-byte blocks of candidate positions until one holds a
+// match of both bytes, and return that block's candidate mask, or 0 when
+// `*blocks` runs out. `gap` is the distance from the first to the last byte.
+// scratch[0..63] holds the saved xmm0-3; the first and last byte patterns
+// are the words at 64 and 68.
+static uint32_t find_pairs_sse2(const unsigned char** p, size_t* blocks,
+                                uint8_t* scratch, size_t gap) {
+    const unsigned char* pos = *p;
+    size_t left = *blocks;
+    uint32_t mask;
+    asm volatile (
+        "movdqu %%xmm0, 0(%3)\n\t"
+        "movdqu %%xmm1, 16(%3)\n\t"
+        "movdqu %%xmm2, 32(%3)\n\t"
+        "movdqu %%xmm3, 48(%3)\n\t"
+        "movd 64(%3), %%xmm0\n\t"
+        "pshufd $0, %%xmm0, %%xmm0\n\t"
+        "movd 68(%3), %%xmm1\n\t"
+        "pshufd $0, %%xmm1, %%xmm1\n\t"
+        "xor %2, %2\n\t"
+        "1:\n\t"
+        "test %1, %1\n\t"
+        "jz 2f\n\t"
+        "movdqu (%0), %%xmm2\n\t"
+        "movdqu (%0,%4), %%xmm3\n\t"
+        "pcmpeqb %%xmm0, %%xmm2\n\t"
+        "pcmpeqb %%xmm1, %%xmm3\n\t"
+        "pand %%xmm3, %%xmm2\n\t"
+        "pmovmskb %%xmm2, %2\n\t"
+        "test %2, %2\n\t"
+        "jnz 2f\n\t"
+        "add $16, %0\n\t"
+        "dec %1\n\t"
+        "jmp 1b\n\t"
+        "2:\n\t"
+        "movdqu 0(%3), %%xmm0\n\t"
+        "movdqu 16(%3), %%xmm1\n\t"
+        "movdqu 32(%3), %%xmm2\n\t"
+        "movdqu 48(%3), %%xmm3"
+        : "+r"(pos), "+r"(left), "=&r"(mask)
+        : "r"(scratch), "r"(gap)
+        : "memory", "cc");
+    *p = pos;
+    *blocks = left;
+    return mask;
+}
+
+void* memmem(const void* haystack, size_t n, const void* needle, size_t m) {
+    const unsigned char* h = (const unsigned char*)haystack;
+    const unsigned char* nd = (const unsigned char*)needle;
+
+    if (m == 0) return (void*)h;
+    if (m > n) return NULL;
+    if (m == 1) return memchr(h, nd[0], n);
+
+    // Last position a match can start at
+    const unsigned char* last = h + (n - m);
+
+    // Every load stays inside the haystack: a block of 16 candidates ends
+    // at most at `last`, and its last-byte load m - 1 bytes further on
+    if (string_features & STRING_SSE2) {
+        size_t blocks = (size_t)(last - h + 1) >> 4;
+        uint8_t scratch[72];
+        word_t* patterns = (word_t*)(scratch + 64);
+        patterns[0] = nd[0] * ONES;
+        patterns[1] = nd[m - 1] * ONES;
+
+        while (blocks) {
+            uint32_t mask = find_pairs_sse2(&h, &blocks, scratch, m - 1);
+            for (; mask; mask &= mask - 1) {
+                const unsigned char* at = h + __builtin_ctz(mask);
+                if (memcmp(at + 1, nd + 1, m - 2) == 0) return (void*)at;
+            }
+            if (blocks) {
+                h += 16;
+                blocks--;
+            }
         }
-    } else {
-        for (size_t i = n; i != 0; i--) {
-            d[i-1] = s[i-1];
+    }
+
+    while (h <= last) {
+        h = (const unsigned char*)memchr(h, nd[0], (size_t)(last - h) + 1);
+        if (!h) return NULL;
+        if (h[m - 1] == nd[m - 1] && memcmp(h + 1, nd + 1, m - 2) == 0) {
+            return (void*)h;
         }
+        h++;
     }
-    return dest;
+    return NULL;
+}
+
+// Finish strlen() 16 bytes at a time from the word-aligned `p`
+static const char* find_zero_sse2(const char* p) {
+    while ((uintptr_t)p & 15) {
+        uint32_t z = has_zero(*(const word_t*)p);
+        if (z) return p + zero_index(z);
+        p += 4;
+    }
+
+    uint8_t saved[32];
+    uint32_t mask;
+    asm volatile (
+        "movdqu %%xmm0, 0(%2)\n\t"
+        "movdqu %%xmm1, 16(%2)\n\t"
+        "pxor %%xmm0, %%xmm0\n\t"
+        "1:\n\t"
+        "movdqa (%0), %%xmm1\n\t"
+        "pcmpeqb %%xmm0, %%xmm1\n\t"
+        "pmovmskb %%xmm1, %1\n\t"
+        "test %1, %1\n\t"
+        "jnz 2f\n\t"
+        "add $16, %0\n\t"
+        "jmp 1b\n\t"
+        "2:\n\t"
+        "movdqu 0(%2), %%xmm0\n\t"
+        "movdqu 16(%2), %%xmm1"
+        : "+r"(p), "=&r"(mask)
+        : "r"(saved)
+        : "memory", "cc");
+    return p + __builtin_ctz(mask);
 }
 
 size_t strlen(const char* s) {
-    size_t len = 0;
-    while (s[len]) len++;
-    return len;
+    const char* p = s;
+    while ((uintptr_t)p & 3) {
+        if (!*p) return p - s;
+        p++;
+    }
+
+    const char* sse2_from = p + SSE2_SCAN_MIN;
+    for (;;) {
+        uint32_t z = has_zero(*(const word_t*)p);
+        if (z) return p + zero_index(z) - s;
+        p += 4;
+        if (p == sse2_from && (string_features & STRING_SSE2)) {
+            return find_zero_sse2(p) - s;
+        }
+    }
+}
+
+char* strchr(const char* s, int c) {
+    char ch = (char)c;
+    while ((uintptr_t)s & 3) {
+        if (*s == ch) return (char*)s;
+        if (!*s) return NULL;
+        s++;
+    }
+
+    // Skip words holding neither the terminator nor `ch`
+    uint32_t pattern = (unsigned char)ch * ONES;
+    for (;;) {
+        uint32_t w = *(const word_t*)s;
+        if (has_zero(w) | has_zero(w ^ pattern)) break;
+        s += 4;
+    }
+
+    while (*s != ch) {
+        if (!*s) return NULL;
+        s++;
+    }
+    return (char*)s;
+}
+
+char* strstr(const char* haystack, const char* needle) {
+    return (char*)memmem(haystack, strlen(haystack), needle, strlen(needle));
 }
 
 char* strcpy(char* dest, const char* src) {
@@ -66,7 +536,34 @@ char* strncpy(char* dest, const char* src, size_t n) {
     return dest;
 }
 
+// strcmp() and strncmp() align s1 and load s2 unaligned, one byte at a time
+// near the end of a page. The word loop stops at the first word that
+// differs or holds a terminator, and the byte loop finds which byte.
 int strcmp(const char* s1, const char* s2) {
+    while ((uintptr_t)s1 & 3) {
+        if (!*s1 || *s1 != *s2) goto bytes;
+        s1++;
+        s2++;
+    }
+
+    for (;;) {
+        if (near_page_end(s2)) {
+            for (int i = 0; i < 4; i++) {
+                if (!s1[i] || s1[i] != s2[i]) {
+                    s1 += i;
+                    s2 += i;
+                    goto bytes;
+                }
+            }
+        } else {
+            uint32_t w = *(const word_t*)s1;
+            if (w != *(const word_t*)s2 || has_zero(w)) break;
+        }
+        s1 += 4;
+        s2 += 4;
+    }
+
+bytes:
     while (*s1 && (*s1 == *s2)) {
         s1++;
         s2++;
@@ -75,28 +572,50 @@ int strcmp(const char* s1, const char* s2) {
 }
 
 int strncmp(const char* s1, const char* s2, size_t n) {
+    while (n && ((uintptr_t)s1 & 3)) {
+        if (!*s1 || *s1 != *s2) goto bytes;
+        s1++;
+        s2++;
+        n--;
+    }
+
+    while (n >= 4) {
+        if (near_page_end(s2)) {
+            for (int i = 0; i < 4; i++) {
+                if (!s1[i] || s1[i] != s2[i]) {
+                    s1 += i;
+                    s2 += i;
+                    n -= i;
+                    goto bytes;
+                }
+            }
+        } else {
+            uint32_t w = *(const word_t*)s1;
+            if (w != *(const word_t*)s2 || has_zero(w)) break;
+        }
+        s1 += 4;
+        s2 += 4;
+        n -= 4;
+    }
+
+bytes:
     while (n && *s1 && (*s1 == *s2)) {
         s1++;
         s2++;
         n--;
     }
+    if (!n) return 0;
     return *(const unsigned char*)s1 - *(const unsigned char*)s2;
 }
 
 char* strcat(char* dest, const char* src) {
-    char* d = dest;
-    while (*d) {
-        d++;
-    }
+    char* d = dest + strlen(dest);
     while ((*d++ = *src++));
     return dest;
 }
 
 char* strncat(char* dest, const char* src, size_t n) {
-    char* d = dest;
-    while (*d) {
-        d++;
-    }
+    char* d = dest + strlen(dest);
     size_t i = 0;
     while (i < n && src[i] != '\0') {
         *d++ = src[i++];
@@ -0,0 +1,211 @@
+#include "libc/include/string.h"
+#include "libc/include/stdint.h"
+
+// Boot-time self-test of the memory routines selected by string_init(), the
+// word-at-a-time scanners and the substring search
+// Every case is checked byte by byte against a plain loop, with guard bytes
+// around the destination to catch writes past either end.
+
+#define TEST_BUF   640
+#define GUARD      0xA5
+
+static uint8_t src_buf[TEST_BUF];
+static uint8_t dst_buf[TEST_BUF];
+static uint8_t ref_buf[TEST_BUF];
+
+// Lengths around every threshold the routines switch on
+static const size_t test_lengths[] = {
+    0, 1, 2, 3, 4, 5, 7, 8, 15, 16, 17, 31, 32, 33, 63, 64, 65,
+    127, 128, 255, 256, 257, 319, 320, 385, 511
+};
+
+#define NUM_LENGTHS (sizeof(test_lengths) / sizeof(test_lengths[0]))
+
+static void fill_pattern(uint8_t *buf, size_t n, uint8_t seed) {
+    for (size_t i = 0; i < n; i++) {
+        buf[i] = (uint8_t)(i * 7 + seed);
+    }
+}
+
+static int same(const uint8_t *a, const uint8_t *b, size_t n) {
+    for (size_t i = 0; i < n; i++) {
+        if (a[i] != b[i]) return 0;
+    }
+    return 1;
+}
+
+static size_t test_copy(void) {
+    for (size_t l = 0; l < NUM_LENGTHS; l++) {
+        size_t len = test_lengths[l];
+        for (size_t so = 0; so < 16; so++) {
+            for (size_t doff = 0; doff < 16; doff++) {
+                fill_pattern(src_buf, TEST_BUF, (uint8_t)so);
+                for (size_t i = 0; i < TEST_BUF; i++) {
+                    dst_buf[i] = GUARD;
+                    ref_buf[i] = GUARD;
+                }
+                for (size_t i = 0; i < len; i++) {
+                    ref_buf[doff + 16 + i] = src_buf[so + i];
+                }
+
+                if (memcpy(dst_buf + doff + 16, src_buf + so, len) != dst_buf + doff + 16 ||
+                    !same(dst_buf, ref_buf, TEST_BUF)) {
+                    return len + 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+static size_t test_fill(void) {
+    for (size_t l = 0; l < NUM_LENGTHS; l++) {
+        size_t len = test_lengths[l];
+        for (size_t doff = 0; doff < 16; doff++) {
+            for (size_t i = 0; i < TEST_BUF; i++) {
+                dst_buf[i] = GUARD;
+                ref_buf[i] = GUARD;
+            }
+            for (size_t i = 0; i < len; i++) {
+                ref_buf[doff + 16 + i] = 0x3C;
+            }
+
+            if (memset(dst_buf + doff + 16, 0x3C, len) != dst_buf + doff + 16 ||
+                !same(dst_buf, ref_buf, TEST_BUF)) {
+                return len + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+// Moves within one buffer, shifted both ways by up to 70 bytes
+static size_t test_move(void) {
+    for (size_t l = 0; l < NUM_LENGTHS; l++) {
+        size_t len = test_lengths[l];
+        if (len + 160 > TEST_BUF) continue;
+
+        for (int shift = -70; shift <= 70; shift++) {
+            size_t from = 80;
+            size_t to = (size_t)((int)from + shift);
+
+            fill_pattern(dst_buf, TEST_BUF, (uint8_t)shift);
+            for (size_t i = 0; i < TEST_BUF; i++) {
+                ref_buf[i] = dst_buf[i];
+            }
+            for (size_t i = 0; i < len; i++) {
+                ref_buf[to + i] = dst_buf[from + i];
+            }
+
+            if (memmove(dst_buf + to, dst_buf + from, len) != dst_buf + to ||
+                !same(dst_buf, ref_buf, TEST_BUF)) {
+                return len + 1;
+            }
+        }
+    }
+    return 0;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+// The scanners against plain loops, for every string start within a word
+// and a 16-byte block and a mismatch at each position
+static size_t test_scan(void) {
+    for (size_t l = 0; l < NUM_LENGTHS; l++) {
+        size_t len = test_lengths[l];
+        if (len + 32 > TEST_BUF) continue;
+
+        for (size_t off = 0; off < 16; off++) {
+            char* a = (char*)src_buf + off;
+            char* b = (char*)dst_buf + 15 - off;
+            for (size_t i = 0; i < len; i++) {
+                a[i] = b[i] = (char)('a' + i % 23);
+            }
+            a[len] = b[len] = '\0';
+
+            if (strlen(a) != len ||
+                strcmp(a, b) != 0 || strncmp(a, b, len + 1) != 0 ||
+                memcmp(a, b, len) != 0 ||
+                strchr(a, '\0') != a + len || strchr(a, '#') != NULL ||
+                memchr(a, '#', len) != NULL) {
+                return len + 1;
+            }
+            if (len && (strchr(a, a[len - 1]) != a + (len - 1) % 23 ||
+                        memchr(a, a[len - 1], len) != strchr(a, a[len - 1]))) {
+                return len + 1;
+            }
+
+            // A byte differing, in both directions; strncmp() stops short of it.
+            // Every position within the first 64 bytes, then a sparser walk.
+            for (size_t at = 0; at < len; at += at < 64 ? 1 : 13) {
+                b[at] = '~';
+                if (sign(strcmp(a, b)) != -1 || sign(strcmp(b, a)) != 1 ||
+                    sign(memcmp(a, b, len)) != -1 ||
+                    strncmp(a, b, at) != 0 || sign(strncmp(a, b, at + 1)) != -1 ||
+                    memchr(b, '~', len) != b + at || strchr(b, '~') != b + at) {
+                    return len + 1;
+                }
+                b[at] = a[at];
+            }
+
+            // A shorter string sorts first
+            if (len) {
+                b[len - 1] = '\0';
+                if (sign(strcmp(a, b)) != 1 || sign(strncmp(b, a, len)) != -1) {
+                    return len + 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+// Reference substring search
+static const uint8_t* naive_search(const uint8_t* h, size_t n, const uint8_t* nd, size_t m) {
+    for (size_t i = 0; i + m <= n; i++) {
+        if (same(h + i, nd, m)) return h + i;
+    }
+    return NULL;
+}
+
+// memmem() and memchr() over haystacks full of near misses: the needle's
+// first and last bytes occur everywhere, and the needle itself is planted
+// at a few positions
+static size_t test_search(void) {
+    static const size_t needle_lengths[] = { 1, 2, 3, 5, 16, 17, 40 };
+    const uint8_t* needle = (const uint8_t*)"xabcdefghijklmnopqrstuvwxyz0123456789ABCDx";
+
+    for (size_t l = 0; l < NUM_LENGTHS; l++) {
+        size_t len = test_lengths[l];
+        for (size_t k = 0; k < sizeof(needle_lengths) / sizeof(needle_lengths[0]); k++) {
+            size_t m = needle_lengths[k];
+            for (size_t at = 0; at + m <= len + 1; at += 1 + at / 8) {
+                for (size_t i = 0; i < len; i++) {
+                    src_buf[i] = (i % 3) ? 'x' : 'a';
+                }
+                if (at + m <= len) {
+                    for (size_t i = 0; i < m; i++) {
+                        src_buf[at + i] = needle[i];
+                    }
+                }
+
+                if (memmem(src_buf, len, needle, m) != naive_search(src_buf, len, needle, m) ||
+                    memchr(src_buf, '#', len) != NULL) {
+                    return len + 1;
+                }
+            }
+        }
+    }
+    return 0;
+}
+
+size_t string_selftest(void) {
+    size_t failed = test_copy();
+    if (!failed) failed = test_fill();
+    if (!failed) failed = test_move();
+    if (!failed) failed = test_scan();
+    if (!failed) failed = test_search();
+    return failed;
+}
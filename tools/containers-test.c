@@ -0,0 +1,496 @@
+// Host test and benchmark for kernel/list.h, kernel/rbtree.h and
+// kernel/hashmap.h
+// The containers are header only and need nothing from the kernel, so this
+// program includes them directly. It runs random operations against a plain
+// array as the reference, checking each structure's invariants as it goes,
+// then times lookups against the singly linked list with linear search that
+// the kernel indexes use today.
+//
+// Usage: containers-test [operations]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <x86intrin.h>
+#include "kernel/list.h"
+#include "kernel/rbtree.h"
+#include "kernel/hashmap.h"
+
+#define KEY_RANGE 2048
+#define BENCH_MAX 65536
+
+typedef struct item {
+    uint32_t key;
+    list_node_t link;
+    rb_node_t rb;
+    hmap_node_t hnode;
+    struct item *next;      // For the singly linked baseline
+    char name[16];
+} item_t;
+
+static int failures;
+static uint32_t rng_state = 0x2545F491;
+
+static uint32_t rng(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        if (failures++ < 20) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } \
+} while (0)
+
+// List
+
+static void test_list(void) {
+    item_t items[8];
+    list_node_t head = LIST_INIT(head);
+    list_node_t *pos, *tmp;
+    item_t *it;
+
+    CHECK(list_empty(&head), "new list not empty");
+    CHECK(!list_first(&head) && !list_last(&head), "empty list has an end");
+
+    for (int i = 0; i < 8; i++) {
+        items[i].key = i;
+        if (i & 1) {
+            list_push_back(&head, &items[i].link);
+        } else {
+            list_push_front(&head, &items[i].link);
+        }
+    }
+
+    // Fronts were pushed in reverse: 6 4 2 0 1 3 5 7
+    static const uint32_t order[] = { 6, 4, 2, 0, 1, 3, 5, 7 };
+    int n = 0;
+    list_for_each_entry(it, &head, link) {
+        CHECK(n < 8 && it->key == order[n], "position %d holds %u", n, it->key);
+        n++;
+    }
+    CHECK(n == 8, "walked %d nodes", n);
+    CHECK(container_of(list_last(&head), item_t, link)->key == 7, "wrong last");
+
+    // Remove the even keys while walking
+    list_for_each_safe(pos, tmp, &head) {
+        if (container_of(pos, item_t, link)->key % 2 == 0) {
+            list_remove(pos);
+        }
+    }
+    n = 0;
+    list_for_each(pos, &head) {
+        CHECK(container_of(pos, item_t, link)->key == 1 + 2 * (uint32_t)n, "odd key %d out of order", n);
+        n++;
+    }
+    CHECK(n == 4, "%d nodes left after removal", n);
+
+    // Removed nodes are detached, so a second removal does nothing
+    list_remove(&items[0].link);
+    list_insert_after(&items[1].link, &items[0].link);
+    list_insert_before(&items[1].link, &items[2].link);
+    list_move_front(&head, &items[7].link);
+    static const uint32_t order2[] = { 7, 2, 1, 0, 3, 5 };
+    n = 0;
+    list_for_each_entry(it, &head, link) {
+        CHECK(n < 6 && it->key == order2[n], "after moves, position %d holds %u", n, it->key);
+        n++;
+    }
+    CHECK(n == 6, "walked %d nodes after moves", n);
+
+    // The back links must mirror the forward ones
+    n = 0;
+    for (pos = head.prev; pos != &head; pos = pos->prev) {
+        CHECK(container_of(pos, item_t, link)->key == order2[5 - n], "backward position %d", n);
+        n++;
+    }
+}
+
+// Red-black tree
+
+static int item_cmp(const rb_node_t *a, const rb_node_t *b) {
+    uint32_t ka = container_of(a, item_t, rb)->key;
+    uint32_t kb = container_of(b, item_t, rb)->key;
+    return ka < kb ? -1 : ka > kb;
+}
+
+static int item_key_cmp(const void *key, const rb_node_t *node) {
+    uint32_t k = *(const uint32_t*)key;
+    uint32_t nk = container_of(node, item_t, rb)->key;
+    return k < nk ? -1 : k > nk;
+}
+
+// Black height of the subtree, checking order, links and colours; -1 when
+// a rule is broken
+static int rb_check(const rb_node_t *node, const rb_node_t *parent, int64_t lo, int64_t hi) {
+    if (!node) {
+        return 1;
+    }
+    uint32_t key = container_of(node, item_t, rb)->key;
+    if (node->parent != parent || key < lo || key > hi) {
+        return -1;
+    }
+    if (node->color == RB_RED && (!rb_is_black(node->left) || !rb_is_black(node->right))) {
+        return -1;
+    }
+    int left = rb_check(node->left, node, lo, key);
+    int right = rb_check(node->right, node, key, hi);
+    if (left < 0 || left != right) {
+        return -1;
+    }
+    return left + (node->color == RB_BLACK);
+}
+
+static void test_rbtree(int ops) {
+    static item_t items[KEY_RANGE];
+    static bool present[KEY_RANGE];
+    rb_tree_t tree = RB_TREE_INIT;
+    int count = 0;
+
+    memset(present, 0, sizeof(present));
+    for (int i = 0; i < KEY_RANGE; i++) {
+        items[i].key = i;
+    }
+
+    for (int op = 0; op < ops; op++) {
+        uint32_t key = rng() % KEY_RANGE;
+        rb_node_t *found = rb_find(&tree, &key, item_key_cmp);
+        CHECK((found != NULL) == present[key], "find %u: %p, expected %d", key, (void*)found, present[key]);
+
+        if (present[key]) {
+            rb_remove(&tree, &items[key].rb);
+            present[key] = false;
+            count--;
+        } else {
+            rb_insert(&tree, &items[key].rb, item_cmp);
+            present[key] = true;
+            count++;
+        }
+
+        // Full checks are O(n), so only now and then
+        if (op % 64 == 0 || op == ops - 1) {
+            CHECK(rb_check(tree.root, NULL, 0, KEY_RANGE) > 0, "invariants broken after op %d", op);
+            CHECK(rb_is_black(tree.root), "red root");
+
+            int n = 0;
+            uint32_t expect = 0;
+            rb_node_t *node;
+            rb_for_each(node, &tree) {
+                while (!present[expect]) {
+                    expect++;
+                }
+                CHECK(container_of(node, item_t, rb)->key == expect, "in-order walk out of step");
+                expect++;
+                n++;
+            }
+            CHECK(n == count, "walked %d of %d nodes", n, count);
+
+            n = 0;
+            for (node = rb_last(&tree); node; node = rb_prev(node)) {
+                n++;
+            }
+            CHECK(n == count, "walked %d of %d nodes backwards", n, count);
+
+            uint32_t probe = rng() % KEY_RANGE;
+            node = rb_lower_bound(&tree, &probe, item_key_cmp);
+            uint32_t next = probe;
+            while (next < KEY_RANGE && !present[next]) {
+                next++;
+            }
+            if (next == KEY_RANGE) {
+                CHECK(node == NULL, "lower bound of %u past the end", probe);
+            } else {
+                CHECK(node && container_of(node, item_t, rb)->key == next, "lower bound of %u", probe);
+            }
+        }
+    }
+
+    // Drain it while walking
+    rb_node_t *node, *tmp;
+    rb_for_each_safe(node, tmp, &tree) {
+        rb_remove(&tree, node);
+    }
+    CHECK(rb_empty(&tree), "tree not empty after draining");
+
+    // Equal keys stay in insertion order
+    static item_t dups[64];
+    for (int i = 0; i < 64; i++) {
+        dups[i].key = i % 4;
+        memcpy(dups[i].name, &i, sizeof(i));
+        rb_insert(&tree, &dups[i].rb, item_cmp);
+    }
+    CHECK(rb_check(tree.root, NULL, 0, 4) > 0, "invariants broken with duplicates");
+    int prev_index = -1;
+    uint32_t prev_key = 0;
+    rb_for_each(node, &tree) {
+        item_t *it = container_of(node, item_t, rb);
+        int index;
+        memcpy(&index, it->name, sizeof(index));
+        if (it->key == prev_key) {
+            CHECK(index > prev_index, "duplicates of %u reordered", it->key);
+        }
+        prev_key = it->key;
+        prev_index = index;
+    }
+}
+
+// Hash map
+
+static uint32_t u32_hash(const void *key) {
+    return hmap_hash_u32(*(const uint32_t*)key);
+}
+
+// Everything in a few buckets, for long probe runs
+static uint32_t bad_hash(const void *key) {
+    return *(const uint32_t*)key % 3;
+}
+
+static bool u32_equal(const hmap_node_t *node, const void *key) {
+    return container_of(node, item_t, hnode)->key == *(const uint32_t*)key;
+}
+
+static uint32_t str_hash(const void *key) {
+    return hmap_hash_str((const char*)key);
+}
+
+static bool str_equal(const hmap_node_t *node, const void *key) {
+    return strcmp(container_of(node, item_t, hnode)->name, (const char*)key) == 0;
+}
+
+static const hmap_ops_t u32_ops = { u32_hash, u32_equal };
+static const hmap_ops_t bad_ops = { bad_hash, u32_equal };
+static const hmap_ops_t str_ops = { str_hash, str_equal };
+
+// Every element must be reachable from its home slot with no free slot and
+// no closer-to-home element in between
+static void hmap_check(const hmap_t *map, int count) {
+    int n = 0;
+    for (uint32_t i = 0; i <= map->mask; i++) {
+        if (!map->slots[i].node) {
+            continue;
+        }
+        n++;
+        CHECK(map->slots[i].hash == map->slots[i].node->hash, "slot %u hash out of date", i);
+        uint32_t dist = hmap_distance(map, i);
+        for (uint32_t d = 1; d <= dist; d++) {
+            uint32_t j = (i - d) & map->mask;
+            CHECK(map->slots[j].node, "gap in the probe run before slot %u", i);
+            if (map->slots[j].node) {
+                CHECK(hmap_distance(map, j) + d >= dist, "Robin Hood order broken at slot %u", i);
+            }
+        }
+    }
+    CHECK(n == count && map->count == (uint32_t)count, "%d slots used, count %u, expected %d", n, map->count, count);
+}
+
+static void test_hashmap_ops(const hmap_ops_t *ops, int nops, const char *what) {
+    static item_t items[KEY_RANGE];
+    static bool present[KEY_RANGE];
+    hmap_t map;
+    uint32_t capacity = 16;
+    hmap_slot_t *slots = malloc(capacity * sizeof(hmap_slot_t));
+    int count = 0;
+    int failed_before = failures;
+
+    memset(present, 0, sizeof(present));
+    for (int i = 0; i < KEY_RANGE; i++) {
+        items[i].key = i;
+    }
+    hmap_init(&map, ops, slots, capacity);
+
+    for (int op = 0; op < nops; op++) {
+        // Bias towards inserting so the table grows through several sizes
+        uint32_t key = rng() % KEY_RANGE;
+        hmap_node_t *found = hmap_find(&map, &key);
+        CHECK((found != NULL) == present[key], "find %u", key);
+        CHECK(!found || found == &items[key].hnode, "find %u returned the wrong element", key);
+
+        if (present[key] && rng() % 3 == 0) {
+            CHECK(hmap_remove(&map, &key) == &items[key].hnode, "remove %u", key);
+            CHECK(hmap_remove(&map, &key) == NULL, "second remove of %u", key);
+            present[key] = false;
+            count--;
+        } else if (!present[key]) {
+            if (hmap_full(&map)) {
+                hmap_slot_t *bigger = malloc(capacity * 2 * sizeof(hmap_slot_t));
+                CHECK(hmap_resize(&map, bigger, capacity / 2) == NULL, "resize to half the slots accepted");
+                hmap_slot_t *old = hmap_resize(&map, bigger, capacity * 2);
+                CHECK(old == slots, "resize returned the wrong array");
+                free(old);
+                slots = bigger;
+                capacity *= 2;
+            }
+            CHECK(hmap_insert(&map, &items[key].hnode, &key), "insert %u", key);
+            present[key] = true;
+            count++;
+        } else {
+            CHECK(!hmap_insert(&map, &items[key].hnode, &key), "duplicate insert of %u", key);
+        }
+
+        if (op % 256 == 0 || op == nops - 1) {
+            hmap_check(&map, count);
+        }
+    }
+
+    int n = 0;
+    uint32_t index;
+    hmap_node_t *node;
+    hmap_for_each(node, index, &map) {
+        CHECK(present[container_of(node, item_t, hnode)->key], "walk found a removed key");
+        n++;
+    }
+    CHECK(n == count, "walked %d of %d elements", n, count);
+
+    free(slots);
+    if (failures != failed_before) {
+        printf("  (hash map with %s)\n", what);
+    }
+}
+
+static void test_hashmap(int ops) {
+    test_hashmap_ops(&u32_ops, ops, "integer keys");
+    test_hashmap_ops(&bad_ops, ops / 8, "a colliding hash");
+
+    // String keys, as for command and file names
+    static item_t items[512];
+    static hmap_slot_t slots[1024];
+    hmap_t map;
+    hmap_init(&map, &str_ops, slots, 1024);
+    for (int i = 0; i < 512; i++) {
+        snprintf(items[i].name, sizeof(items[i].name), "cmd%d", i);
+        CHECK(hmap_insert(&map, &items[i].hnode, items[i].name), "insert %s", items[i].name);
+    }
+    for (int i = 0; i < 512; i++) {
+        char name[16];
+        snprintf(name, sizeof(name), "cmd%d", i);
+        CHECK(hmap_find(&map, name) == &items[i].hnode, "find %s", name);
+    }
+    CHECK(hmap_find(&map, "cmd512") == NULL, "found a missing name");
+    hmap_check(&map, 512);
+}
+
+// Benchmark
+
+static item_t *bench_items;
+static uint32_t *bench_keys;
+
+// The kernel's current approach: walk a singly linked list
+static item_t *slist_find(item_t *head, uint32_t key) {
+    for (item_t *it = head; it; it = it->next) {
+        if (it->key == key) {
+            return it;
+        }
+    }
+    return NULL;
+}
+
+static double cycles_per_lookup(uint64_t cycles, int lookups) {
+    return (double)cycles / lookups;
+}
+
+static void bench(void) {
+    bench_items = malloc(BENCH_MAX * sizeof(item_t));
+    bench_keys = malloc(BENCH_MAX * sizeof(uint32_t));
+    hmap_slot_t *slots = malloc(2 * BENCH_MAX * sizeof(hmap_slot_t));
+
+    printf("\nCycles per lookup of a present key\n");
+    printf("%8s %12s %12s %12s %14s %14s\n", "n", "slist", "rbtree", "hashmap", "rb insert", "hmap insert");
+
+    for (int n = 16; n <= BENCH_MAX; n *= 4) {
+        // Random distinct keys, inserted in random order
+        for (int i = 0; i < n; i++) {
+            bench_keys[i] = i * 2654435761U;
+        }
+        for (int i = n - 1; i > 0; i--) {
+            int j = rng() % (i + 1);
+            uint32_t t = bench_keys[i];
+            bench_keys[i] = bench_keys[j];
+            bench_keys[j] = t;
+        }
+
+        item_t *head = NULL;
+        rb_tree_t tree = RB_TREE_INIT;
+        hmap_t map;
+        uint32_t capacity = 2;
+        while (hmap_over_load(n, capacity)) {
+            capacity *= 2;
+        }
+        hmap_init(&map, &u32_ops, slots, capacity);
+
+        uint64_t start = __rdtsc();
+        for (int i = 0; i < n; i++) {
+            bench_items[i].key = bench_keys[i];
+            rb_insert(&tree, &bench_items[i].rb, item_cmp);
+        }
+        uint64_t rb_insert_cycles = __rdtsc() - start;
+
+        start = __rdtsc();
+        for (int i = 0; i < n; i++) {
+            hmap_insert(&map, &bench_items[i].hnode, &bench_keys[i]);
+        }
+        uint64_t hmap_insert_cycles = __rdtsc() - start;
+
+        for (int i = 0; i < n; i++) {
+            bench_items[i].next = head;
+            head = &bench_items[i];
+        }
+
+        // Enough lookups for a stable figure, fewer for the slow list
+        int lookups = 1 << 20;
+        int slist_lookups = n > 4096 ? 4096 : lookups / n * 16;
+        volatile uintptr_t sink = 0;
+
+        start = __rdtsc();
+        for (int i = 0; i < slist_lookups; i++) {
+            sink += (uintptr_t)slist_find(head, bench_keys[rng() % n]);
+        }
+        double slist = cycles_per_lookup(__rdtsc() - start, slist_lookups);
+
+        start = __rdtsc();
+        for (int i = 0; i < lookups; i++) {
+            uint32_t key = bench_keys[rng() % n];
+            sink += (uintptr_t)rb_find(&tree, &key, item_key_cmp);
+        }
+        double rb = cycles_per_lookup(__rdtsc() - start, lookups);
+
+        start = __rdtsc();
+        for (int i = 0; i < lookups; i++) {
+            uint32_t key = bench_keys[rng() % n];
+            sink += (uintptr_t)hmap_find(&map, &key);
+        }
+        double hm = cycles_per_lookup(__rdtsc() - start, lookups);
+
+        printf("%8d %12.1f %12.1f %12.1f %14.1f %14.1f\n", n, slist, rb, hm,
+               (double)rb_insert_cycles / n, (double)hmap_insert_cycles / n);
+        (void)sink;
+    }
+
+    free(slots);
+    free(bench_keys);
+    free(bench_items);
+}
+
+int main(int argc, char **argv) {
+    int ops = argc > 1 ? atoi(argv[1]) : 200000;
+
+    test_list();
+    test_rbtree(ops);
+    test_hashmap(ops);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("list, rbtree and hashmap: all tests passed (%d operations)\n", ops);
+
+    bench();
+    return 0;
+}
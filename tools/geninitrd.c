@@ -2,31 +2,61 @@
 #include <stdlib.h>
 #include <string.h>
 #include <stdint.h>
+#include "kernel/hash.h"
 
+// Must match fs/src/initrd.c
 struct initrd_file_header {
-    char magic[8];
+    char magic[6];
+    uint8_t version;
+    uint8_t hash;
     uint32_t nheaders;
+    uint32_t size;
+    uint32_t checksum;
 } __attribute__((packed));
 
 struct initrd_file_headers {
     char name[64];
     uint32_t offset;
     uint32_t length;
+    uint32_t checksum;
 } __attribute__((packed));
 
+#define INITRD_VERSION     2
+#define INITRD_HASH_CRC32C 1
+#define INITRD_HASH_XXH32  2
+
+static uint32_t checksum(int hash, const void *data, size_t len) {
+    if (hash == INITRD_HASH_XXH32) {
+        return xxhash32(data, len, 0);
+    }
+    return crc32c(0, data, len);
+}
+
 int main(int argc, char **argv) {
+    const char *program = argv[0];
+    int hash = INITRD_HASH_CRC32C;
+    if (argc > 1 && strcmp(argv[1], "-x") == 0) {
+        hash = INITRD_HASH_XXH32;
+        argv++;
+        argc--;
+    }
+
     if (argc < 3) {
-        printf("Usage: %s <output_file> <file1> [file2] ...\n", argv[0]);
+        printf("Usage: %s [-x] <output_file> <file1> [file2] ...\n", program);
+        printf("  -x  checksum with xxHash32 instead of CRC32C\n");
         return 1;
     }
 
+    hash_init(0);
+
     int nheaders = argc - 2;
     struct initrd_file_header header;
-    struct initrd_file_headers *headers = (struct initrd_file_headers *)malloc(sizeof(struct initrd_file_headers) * nheaders);
+    struct initrd_file_headers *headers = (struct initrd_file_headers *)calloc(nheaders, sizeof(struct initrd_file_headers));
+    char **contents = (char **)calloc(nheaders, sizeof(char *));
 
-    strncpy(header.magic, "INITRD", 6);
-    header.magic[6] = '\0';
-    header.magic[7] = '\0';
+    memcpy(header.magic, "INITRD", 6);
+    header.version = INITRD_VERSION;
+    header.hash = hash;
     header.nheaders = nheaders;
 
     printf("Creating initrd with %d files...\n", nheaders);
@@ -37,6 +67,11 @@ int main(int argc, char **argv) {
         char *file_name = argv[i + 2];
         printf("Adding %s...\n", file_name);
 
+        if (strlen(file_name) >= sizeof(headers[i].name)) {
+            printf("Error: file name too long: %s\n", file_name);
+            return 1;
+        }
+
         FILE *stream = fopen(file_name, "rb");
         if (stream == 0) {
             printf("Error: file not found: %s\n", file_name);
@@ -47,13 +82,23 @@ int main(int argc, char **argv) {
         long file_size = ftell(stream);
         fseek(stream, 0, SEEK_SET);
 
-        strncpy(headers[i].name, file_name, 64);
+        contents[i] = (char *)malloc(file_size ? file_size : 1);
+        if (fread(contents[i], 1, file_size, stream) != (size_t)file_size) {
+            printf("Error: could not read %s\n", file_name);
+            return 1;
+        }
+        fclose(stream);
+
+        strcpy(headers[i].name, file_name);
         headers[i].offset = offset;
         headers[i].length = file_size;
+        headers[i].checksum = checksum(hash, contents[i], file_size);
         offset += file_size;
-        fclose(stream);
     }
 
+    header.size = offset;
+    header.checksum = checksum(hash, headers, sizeof(struct initrd_file_headers) * nheaders);
+
     FILE *wstream = fopen(argv[1], "wb");
     if (wstream == 0) {
         printf("Error: could not open output file: %s\n", argv[1]);
@@ -64,21 +109,13 @@ int main(int argc, char **argv) {
     fwrite(headers, sizeof(struct initrd_file_headers), nheaders, wstream);
 
     for (int i = 0; i < nheaders; i++) {
-        char *file_name = argv[i + 2];
-        FILE *stream = fopen(file_name, "rb");
-        fseek(stream, 0, SEEK_END);
-        long file_size = ftell(stream);
-        fseek(stream, 0, SEEK_SET);
-
-        char *buf = (char *)malloc(file_size);
-        fread(buf, 1, file_size, stream);
-        fwrite(buf, 1, file_size, wstream);
-        fclose(stream);
-        free(buf);
+        fwrite(contents[i], 1, headers[i].length, wstream);
+        free(contents[i]);
     }
 
     fclose(wstream);
     free(headers);
+    free(contents);
 
     printf("Done.\n");
 
@@ -0,0 +1,379 @@
+// Host test and benchmark for libc/string.c
+// The Makefile builds libc/string.c for the host with every routine renamed
+// to skull_*, so it links next to the host C library. This program fuzzes
+// each routine against the host version under every CPU feature set the
+// host supports, then times both in cycles per byte.
+//
+// Usage: libc-bench [iterations]
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <cpuid.h>
+#include <x86intrin.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+// Must match libc/include/string.h
+#define STRING_ERMS 0x1
+#define STRING_SSE2 0x2
+
+void *skull_memcpy(void *dest, const void *src, size_t n);
+void *skull_memset(void *s, int c, size_t n);
+int skull_memcmp(const void *s1, const void *s2, size_t n);
+void *skull_memmove(void *dest, const void *src, size_t n);
+void *skull_memchr(const void *s, int c, size_t n);
+void *skull_memmem(const void *haystack, size_t n, const void *needle, size_t m);
+size_t skull_strlen(const char *s);
+char *skull_strcpy(char *dest, const char *src);
+char *skull_strncpy(char *dest, const char *src, size_t n);
+int skull_strcmp(const char *s1, const char *s2);
+int skull_strncmp(const char *s1, const char *s2, size_t n);
+char *skull_strcat(char *dest, const char *src);
+char *skull_strncat(char *dest, const char *src, size_t n);
+char *skull_strchr(const char *s, int c);
+char *skull_strstr(const char *haystack, const char *needle);
+char *skull_itoa(int value, char *str, int base);
+void skull_string_init(int features);
+size_t skull_string_selftest(void);
+
+#define BUF_SIZE   (8192 + 256)
+#define BENCH_MAX  (1024 * 1024)
+
+static uint8_t *buf_a;
+static uint8_t *buf_b;
+static uint8_t *buf_ref;
+static uint8_t *page;           // Two pages, the second one inaccessible
+static long page_size;
+static int failures;
+
+// Feature set being tested, for failure messages
+static int cur_features;
+
+static uint32_t rng_state = 0x12345678;
+
+static uint32_t rng(void) {
+    // xorshift32
+    rng_state ^= rng_state << 13;
+    rng_state ^= rng_state >> 17;
+    rng_state ^= rng_state << 5;
+    return rng_state;
+}
+
+// Mostly short lengths, with the occasional long one
+static size_t rand_len(size_t max) {
+    size_t len;
+    switch (rng() % 4) {
+    case 0:  len = rng() % 16; break;
+    case 1:  len = rng() % 96; break;
+    case 2:  len = rng() % 600; break;
+    default: len = rng() % max; break;
+    }
+    return len < max ? len : max - 1;
+}
+
+static int sign(int v) {
+    return (v > 0) - (v < 0);
+}
+
+static void fail(const char *what, size_t len, size_t a, size_t b) {
+    if (failures++ < 20) {
+        printf("FAIL %s features=%d len=%zu args=%zu,%zu\n", what, cur_features, len, a, b);
+    }
+}
+
+// Random bytes from a small alphabet so that matches are common
+static void fill_text(uint8_t *p, size_t n, int alphabet) {
+    for (size_t i = 0; i < n; i++) {
+        p[i] = 'a' + rng() % alphabet;
+    }
+}
+
+static void fuzz_memory(void) {
+    size_t len = rand_len(4096);
+    size_t so = rng() % 64;
+    size_t doff = rng() % 64;
+    fill_text(buf_a, BUF_SIZE, 26);
+    fill_text(buf_b, BUF_SIZE, 26);
+    memcpy(buf_ref, buf_b, BUF_SIZE);
+
+    switch (rng() % 5) {
+    case 0:
+        if (skull_memcpy(buf_b + doff, buf_a + so, len) != buf_b + doff) fail("memcpy ret", len, so, doff);
+        memcpy(buf_ref + doff, buf_a + so, len);
+        if (memcmp(buf_b, buf_ref, BUF_SIZE)) fail("memcpy", len, so, doff);
+        break;
+    case 1: {
+        int c = rng() & 0xFF;
+        if (skull_memset(buf_b + doff, c, len) != buf_b + doff) fail("memset ret", len, doff, c);
+        memset(buf_ref + doff, c, len);
+        if (memcmp(buf_b, buf_ref, BUF_SIZE)) fail("memset", len, doff, c);
+        break;
+    }
+    case 2: {
+        // Overlapping in either direction
+        size_t from = 64 + rng() % 128;
+        size_t to = from + rng() % 129 - 64;
+        if (skull_memmove(buf_b + to, buf_b + from, len) != buf_b + to) fail("memmove ret", len, from, to);
+        memmove(buf_ref + to, buf_ref + from, len);
+        if (memcmp(buf_b, buf_ref, BUF_SIZE)) fail("memmove", len, from, to);
+        break;
+    }
+    case 3: {
+        // Equal, then one byte changed at a random position
+        memcpy(buf_b + doff, buf_a + so, len);
+        if (len && rng() % 4) {
+            buf_b[doff + rng() % len] = rng() & 0xFF;
+        }
+        int got = skull_memcmp(buf_a + so, buf_b + doff, len);
+        int want = memcmp(buf_a + so, buf_b + doff, len);
+        if (sign(got) != sign(want)) fail("memcmp", len, so, doff);
+        break;
+    }
+    default: {
+        int c = 'a' + rng() % 30;
+        if (skull_memchr(buf_a + so, c, len) != memchr(buf_a + so, c, len)) fail("memchr", len, so, c);
+        break;
+    }
+    }
+}
+
+static void fuzz_search(void) {
+    size_t n = rand_len(4096);
+    size_t m = rng() % 4 ? rng() % 8 : rng() % 64;
+    int alphabet = 2 + rng() % 4;
+    fill_text(buf_a, n, alphabet);
+    buf_a[n] = '\0';
+
+    // Half the needles come from the haystack itself
+    if (m <= n && rng() % 2) {
+        memcpy(buf_b, buf_a + rng() % (n - m + 1), m);
+    } else {
+        fill_text(buf_b, m, alphabet);
+    }
+    buf_b[m] = '\0';
+
+    if (skull_memmem(buf_a, n, buf_b, m) != memmem(buf_a, n, buf_b, m)) fail("memmem", n, m, alphabet);
+    if (skull_strstr((char*)buf_a, (char*)buf_b) != strstr((char*)buf_a, (char*)buf_b)) fail("strstr", n, m, alphabet);
+}
+
+static void fuzz_strings(void) {
+    size_t len = rand_len(2048);
+    size_t so = rng() % 64;
+    size_t doff = rng() % 64;
+    char *a = (char*)buf_a + so;
+    char *b = (char*)buf_b + doff;
+    fill_text((uint8_t*)a, len, 26);
+    a[len] = '\0';
+    memcpy(b, a, len + 1);
+    if (len && rng() % 2) {
+        size_t at = rng() % len;
+        b[at] = rng() % 3 ? 'a' + rng() % 26 : '\0';
+    }
+
+    if (skull_strlen(a) != strlen(a)) fail("strlen", len, so, 0);
+    int c = rng() % 8 ? 'a' + rng() % 27 : '\0';
+    if (skull_strchr(a, c) != strchr(a, c)) fail("strchr", len, so, c);
+    if (sign(skull_strcmp(a, b)) != sign(strcmp(a, b))) fail("strcmp", len, so, doff);
+    size_t n = rand_len(len + 8);
+    if (sign(skull_strncmp(a, b, n)) != sign(strncmp(a, b, n))) fail("strncmp", len, so, n);
+
+    // Copies and appends into guarded buffers
+    memset(buf_ref, 0x5A, BUF_SIZE);
+    memset(buf_b, 0x5A, BUF_SIZE);
+    char *d = (char*)buf_b + 128 + doff;
+    char *r = (char*)buf_ref + 128 + doff;
+    switch (rng() % 4) {
+    case 0:
+        skull_strcpy(d, a);
+        strcpy(r, a);
+        break;
+    case 1:
+        skull_strncpy(d, a, n);
+        strncpy(r, a, n);
+        break;
+    case 2:
+        strcpy(d, "prefix");
+        strcpy(r, "prefix");
+        skull_strcat(d, a);
+        strcat(r, a);
+        break;
+    default:
+        strcpy(d, "prefix");
+        strcpy(r, "prefix");
+        skull_strncat(d, a, n);
+        strncat(r, a, n);
+        break;
+    }
+    if (memcmp(buf_b, buf_ref, BUF_SIZE)) fail("strcpy/strcat", len, doff, n);
+
+    char got[40], want[40];
+    int v = (int)rng();
+    skull_itoa(v, got, 10);
+    snprintf(want, sizeof(want), "%d", v);
+    if (strcmp(got, want)) fail("itoa", 0, (size_t)(unsigned)v, 10);
+}
+
+// Strings ending right before an inaccessible page: a scanner that reads
+// past the terminator across the page boundary crashes here
+static void fuzz_page_end(void) {
+    size_t len = rng() % 80;
+    char *s = (char*)page + page_size - len - 1;
+    fill_text((uint8_t*)s, len, 26);
+    s[len] = '\0';
+
+    char *t = (char*)buf_a + rng() % 16;
+    memcpy(t, s, len + 1);
+
+    if (skull_strlen(s) != len) fail("strlen page end", len, 0, 0);
+    if (skull_strchr(s, '#') != NULL) fail("strchr page end", len, 0, 0);
+    if (skull_strcmp(t, s) != 0 || skull_strcmp(s, t) != 0) fail("strcmp page end", len, 0, 0);
+    if (skull_strncmp(t, s, len + 100) != 0) fail("strncmp page end", len, 0, 0);
+    if (skull_memchr(s, '#', len) != NULL) fail("memchr page end", len, 0, 0);
+}
+
+static int detect_features(void) {
+    unsigned int eax, ebx, ecx, edx;
+    int features = 0;
+    if (__get_cpuid(1, &eax, &ebx, &ecx, &edx) && (edx & bit_SSE2)) {
+        features |= STRING_SSE2;
+    }
+    if (__get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) && (ebx & (1 << 9))) {
+        features |= STRING_ERMS;
+    }
+    return features;
+}
+
+// Benchmarks call through volatile pointers so that the compiler cannot
+// inline or drop the host routines
+typedef void *(*copy_fn)(void *, const void *, size_t);
+typedef void *(*fill_fn)(void *, int, size_t);
+typedef int (*cmp_fn)(const void *, const void *, size_t);
+typedef void *(*chr_fn)(const void *, int, size_t);
+typedef size_t (*len_fn)(const char *);
+typedef void *(*mem_fn)(const void *, size_t, const void *, size_t);
+
+static volatile uintptr_t bench_sink;
+
+enum { OP_MEMCPY, OP_MEMMOVE, OP_MEMSET, OP_MEMCMP, OP_MEMCHR, OP_STRLEN, OP_MEMMEM, NUM_OPS };
+
+static const char *op_names[NUM_OPS] = {
+    "memcpy", "memmove", "memset", "memcmp", "memchr", "strlen", "memmem"
+};
+
+static double run_op(int op, int skull, uint8_t *dst, uint8_t *src, size_t size) {
+    static copy_fn volatile copies[2] = { memcpy, skull_memcpy };
+    static copy_fn volatile moves[2] = { memmove, skull_memmove };
+    static fill_fn volatile fills[2] = { memset, skull_memset };
+    static cmp_fn volatile cmps[2] = { memcmp, skull_memcmp };
+    static chr_fn volatile chrs[2] = { memchr, skull_memchr };
+    static len_fn volatile lens[2] = { strlen, skull_strlen };
+    static mem_fn volatile mems[2] = { memmem, skull_memmem };
+
+    // Enough repetitions for about 16 MB per trial, best of five trials
+    size_t reps = (16u << 20) / size;
+    if (reps < 4) reps = 4;
+    double best = 0;
+
+    for (int trial = 0; trial < 5; trial++) {
+        uint64_t start = __rdtsc();
+        for (size_t i = 0; i < reps; i++) {
+            switch (op) {
+            case OP_MEMCPY:  bench_sink += (uintptr_t)copies[skull](dst, src, size); break;
+            case OP_MEMMOVE: bench_sink += (uintptr_t)moves[skull](dst + 1, dst, size - 1); break;
+            case OP_MEMSET:  bench_sink += (uintptr_t)fills[skull](dst, 0x55, size); break;
+            case OP_MEMCMP:  bench_sink += cmps[skull](dst, src, size); break;
+            case OP_MEMCHR:  bench_sink += (uintptr_t)chrs[skull](src, '#', size); break;
+            case OP_STRLEN:  bench_sink += lens[skull]((const char*)src); break;
+            default:         bench_sink += (uintptr_t)mems[skull](src, size, "abcdefgh#", 9); break;
+            }
+        }
+        double cycles = (double)(__rdtsc() - start) / ((double)reps * size);
+        if (trial == 0 || cycles < best) best = cycles;
+    }
+    return best;
+}
+
+static void benchmark(int features) {
+    uint8_t *src = aligned_alloc(64, BENCH_MAX + 64);
+    uint8_t *dst = aligned_alloc(64, BENCH_MAX + 64);
+    if (!src || !dst) {
+        printf("Out of memory\n");
+        exit(1);
+    }
+
+    skull_string_init(features);
+    printf("\nCycles per byte, features=%d (skull / host)\n", features);
+    printf("%-8s", "size");
+    for (int op = 0; op < NUM_OPS; op++) {
+        printf("%18s", op_names[op]);
+    }
+    printf("\n");
+
+    for (size_t size = 16; size <= BENCH_MAX; size *= 4) {
+        // Text without '#' and without a terminator until the end, so
+        // every scan runs the full length
+        fill_text(src, size, 26);
+        src[size - 1] = '\0';
+
+        printf("%-8zu", size);
+        for (int op = 0; op < NUM_OPS; op++) {
+            // memcmp compares equal buffers, so undo earlier writes to dst
+            memcpy(dst, src, size);
+            double skull = run_op(op, 1, dst, src, size);
+            memcpy(dst, src, size);
+            double host = run_op(op, 0, dst, src, size);
+            printf("   %6.3f / %6.3f", skull, host);
+        }
+        printf("\n");
+    }
+
+    free(src);
+    free(dst);
+}
+
+int main(int argc, char **argv) {
+    long iterations = argc > 1 ? atol(argv[1]) : 50000;
+
+    buf_a = malloc(BUF_SIZE);
+    buf_b = malloc(BUF_SIZE);
+    buf_ref = malloc(BUF_SIZE);
+    page_size = sysconf(_SC_PAGESIZE);
+    page = mmap(NULL, 2 * page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (!buf_a || !buf_b || !buf_ref || page == MAP_FAILED ||
+        mprotect(page + page_size, page_size, PROT_NONE) != 0) {
+        printf("Cannot allocate test buffers\n");
+        return 1;
+    }
+
+    int host = detect_features();
+    printf("Host features: %s%s\n", host & STRING_SSE2 ? "SSE2 " : "",
+           host & STRING_ERMS ? "ERMS" : "");
+
+    for (int features = 0; features <= (STRING_ERMS | STRING_SSE2); features++) {
+        if (features & ~host) continue;
+        cur_features = features;
+        skull_string_init(features);
+
+        size_t selftest = skull_string_selftest();
+        if (selftest) fail("string_selftest", selftest - 1, 0, 0);
+
+        for (long i = 0; i < iterations; i++) {
+            fuzz_memory();
+            fuzz_search();
+            fuzz_strings();
+            fuzz_page_end();
+        }
+        printf("features=%d: %ld iterations, %d failures so far\n", features, iterations, failures);
+    }
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+
+    benchmark(host);
+    return 0;
+}
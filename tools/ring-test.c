@@ -0,0 +1,179 @@
+// Host test and benchmark for kernel/ring.h
+// Checks the single-threaded edge cases (wrap-around, full and empty rings,
+// the drop counter), then runs a producer and a consumer thread against each
+// other with random bulk sizes and checks that every element arrives once
+// and in order. On the host the two threads really run at the same time, so
+// this also exercises the acquire/release pairing that the kernel relies on
+// between an IRQ handler and the code it interrupts.
+//
+// Usage: ring-test [elements]
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sched.h>
+#include <time.h>
+#include "kernel/ring.h"
+
+#define STRESS_CAPACITY 256
+#define MAX_BULK        64
+
+static int failures;
+
+#define CHECK(cond, ...) do { \
+    if (!(cond)) { \
+        if (failures++ < 20) { \
+            printf("FAIL %s:%d: ", __FILE__, __LINE__); \
+            printf(__VA_ARGS__); \
+            printf("\n"); \
+        } \
+    } \
+} while (0)
+
+static void test_basic(void) {
+    uint8_t storage[8];
+    ring_t ring;
+    uint8_t byte;
+
+    ring_init(&ring, storage, sizeof(storage), 1);
+    CHECK(ring_empty(&ring) && !ring_pop(&ring, &byte), "new ring not empty");
+
+    // Every slot is usable, then pushes are dropped and counted
+    for (uint8_t i = 0; i < 8; i++) {
+        CHECK(ring_push(&ring, &i), "push %u into a ring with room", i);
+    }
+    byte = 99;
+    CHECK(!ring_push(&ring, &byte), "push into a full ring");
+    CHECK(ring.dropped == 1 && ring.high_water == 8, "dropped %u, high water %u", ring.dropped, ring.high_water);
+
+    CHECK(ring_peek(&ring, 7, &byte) && byte == 7, "peek at the back");
+    CHECK(!ring_peek(&ring, 8, &byte), "peek past the back");
+
+    // Bulk operations wrap around the end of the storage
+    uint8_t out[8], in[8] = { 10, 11, 12, 13, 14, 15, 16, 17 };
+    CHECK(ring_pop_bulk(&ring, out, 5) == 5 && out[0] == 0 && out[4] == 4, "bulk pop");
+    CHECK(ring_push_bulk(&ring, in, 8) == 5, "bulk push into 5 free slots");
+    CHECK(ring.dropped == 4, "dropped %u after a partial bulk push", ring.dropped);
+    CHECK(ring_pop_bulk(&ring, out, 8) == 8, "bulk pop of a full ring");
+    static const uint8_t expect[8] = { 5, 6, 7, 10, 11, 12, 13, 14 };
+    for (int i = 0; i < 8; i++) {
+        CHECK(out[i] == expect[i], "element %d is %u, expected %u", i, out[i], expect[i]);
+    }
+    CHECK(ring_empty(&ring), "ring not empty after draining");
+
+    // Wider elements, and indices running past 2^32
+    uint32_t wide[4], value;
+    ring_init(&ring, wide, 4, sizeof(uint32_t));
+    ring.head = ring.tail = 0xFFFFFFFEU;
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(ring_push(&ring, &i), "push %u near the index wrap", i);
+    }
+    CHECK(ring_count(&ring) == 4, "count %u across the index wrap", ring_count(&ring));
+    for (uint32_t i = 0; i < 4; i++) {
+        CHECK(ring_pop(&ring, &value) && value == i, "pop %u near the index wrap", i);
+    }
+
+    ring_push(&ring, &value);
+    ring_flush(&ring);
+    CHECK(ring_empty(&ring), "flush left elements");
+}
+
+static ring_t stress_ring;
+static uint32_t stress_storage[STRESS_CAPACITY];
+static uint32_t stress_total;
+
+// xorshift32, one state per thread
+static uint32_t rng(uint32_t *state) {
+    *state ^= *state << 13;
+    *state ^= *state >> 17;
+    *state ^= *state << 5;
+    return *state;
+}
+
+static void *producer(void *arg) {
+    uint32_t state = 0x1234567;
+    uint32_t batch[MAX_BULK];
+    uint32_t next = 0;
+    (void)arg;
+
+    while (next < stress_total) {
+        uint32_t n = 1 + rng(&state) % MAX_BULK;
+        if (n > stress_total - next) {
+            n = stress_total - next;
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            batch[i] = next + i;
+        }
+        // Retry what did not fit, so nothing is lost; the drop counter
+        // still records the refusals
+        uint32_t done = 0;
+        while (done < n) {
+            uint32_t pushed = ring_push_bulk(&stress_ring, batch + done, n - done);
+            if (!pushed) {
+                sched_yield();      // Let the consumer run on a single CPU
+            }
+            done += pushed;
+        }
+        next += n;
+    }
+    return NULL;
+}
+
+static void *consumer(void *arg) {
+    uint32_t state = 0x7654321;
+    uint32_t batch[MAX_BULK];
+    uint32_t expect = 0;
+    (void)arg;
+
+    while (expect < stress_total) {
+        uint32_t n = ring_pop_bulk(&stress_ring, batch, 1 + rng(&state) % MAX_BULK);
+        if (!n) {
+            sched_yield();
+        }
+        for (uint32_t i = 0; i < n; i++) {
+            // Carry on from what arrived so the producer is not left
+            // waiting on a full ring
+            CHECK(batch[i] == expect, "received %u, expected %u", batch[i], expect);
+            expect = batch[i] + 1;
+        }
+    }
+    return NULL;
+}
+
+static void test_stress(uint32_t total) {
+    pthread_t threads[2];
+    struct timespec start, end;
+
+    stress_total = total;
+    ring_init(&stress_ring, stress_storage, STRESS_CAPACITY, sizeof(uint32_t));
+
+    clock_gettime(CLOCK_MONOTONIC, &start);
+    pthread_create(&threads[0], NULL, consumer, NULL);
+    pthread_create(&threads[1], NULL, producer, NULL);
+    pthread_join(threads[1], NULL);
+    pthread_join(threads[0], NULL);
+    clock_gettime(CLOCK_MONOTONIC, &end);
+
+    CHECK(ring_empty(&stress_ring), "elements left after the consumer finished");
+
+    double seconds = (end.tv_sec - start.tv_sec) + (end.tv_nsec - start.tv_nsec) / 1e9;
+    printf("%u elements through a %u-slot ring in %.3f s (%.1f M/s), "
+           "%u refused while full, peak fill %u\n",
+           total, STRESS_CAPACITY, seconds, total / seconds / 1e6,
+           stress_ring.dropped, stress_ring.high_water);
+}
+
+int main(int argc, char **argv) {
+    uint32_t total = argc > 1 ? (uint32_t)atoi(argv[1]) : 20000000;
+
+    test_basic();
+    test_stress(total);
+
+    if (failures) {
+        printf("%d failures\n", failures);
+        return 1;
+    }
+    printf("ring: all tests passed\n");
+    return 0;
+}